@@ -0,0 +1,369 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Times the daemon's hot paths and prints the results as JSON, so they can be
+// compared between releases.  Usage:
+//
+//   sel-logger-benchmark [--max-lines N] [--dir PATH]
+//
+// --max-lines caps the size of the generated ipmi_sel files (1000000 by
+// default) and --dir is where they are generated (a new directory in /tmp by
+// default, removed afterwards).
+
+#include <record_id_bitmap.hpp>
+#include <sel_format.hpp>
+#include <sel_journal.hpp>
+#include <sel_log_index.hpp>
+#include <sensorutils.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Every heap allocation in the process is counted, so a benchmark can show
+// that a path doesn't allocate
+static std::atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size != 0 ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint16_t selInvalidRecordId = 0xFFFF;
+
+struct BenchmarkResult
+{
+    std::string name;
+    size_t iterations;
+    double nsPerOp;
+    double allocationsPerOp;
+};
+
+// Keep the compiler from optimizing away a result that is never used
+template <typename T>
+void keep(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Time iterations calls of op(i), after a few untimed calls that bring
+// caches and reused buffers to their steady state
+template <typename Op>
+void runBenchmark(std::vector<BenchmarkResult>& results, std::string name,
+                  size_t iterations, Op&& op)
+{
+    size_t warmup = std::min<size_t>(iterations, 16);
+    for (size_t i = 0; i < warmup; i++)
+    {
+        op(i);
+    }
+    size_t allocationsBefore = allocationCount.load();
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        op(warmup + i);
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    size_t allocations = allocationCount.load() - allocationsBefore;
+
+    results.push_back(BenchmarkResult{
+        std::move(name), iterations, elapsed.count() / iterations,
+        static_cast<double>(allocations) / iterations});
+}
+
+struct SensorRange
+{
+    const char* name;
+    double min;
+    double max;
+};
+
+// Ranges of the kinds of sensors a BMC typically has
+constexpr std::array<SensorRange, 5> sensorRanges{{
+    {"temperature", -128, 127},
+    {"voltage", 0, 15.3},
+    {"current", 0, 255},
+    {"fan", 0, 25000},
+    {"power", 0, 3000},
+}};
+
+void benchmarkScaling(std::vector<BenchmarkResult>& results)
+{
+    constexpr size_t steps = 1024;
+    for (const SensorRange& range : sensorRanges)
+    {
+        runBenchmark(results,
+                     std::string("getScaledIPMIValue/") + range.name, 1000000,
+                     [&range](size_t i) {
+                         double value = range.min + (range.max - range.min) *
+                                                        (i % steps) / steps;
+                         keep(ipmi::getScaledIPMIValue(value, range.max,
+                                                       range.min));
+                     });
+        runBenchmark(results,
+                     std::string("getSensorAttributes/") + range.name, 100000,
+                     [&range](size_t) {
+                         int16_t mValue = 0;
+                         int8_t rExp = 0;
+                         int16_t bValue = 0;
+                         int8_t bExp = 0;
+                         bool bSigned = false;
+                         keep(ipmi::getSensorAttributes(range.max, range.min,
+                                                        mValue, rExp, bValue,
+                                                        bExp, bSigned));
+                         keep(mValue);
+                     });
+    }
+}
+
+void benchmarkFormatting(std::vector<BenchmarkResult>& results)
+{
+    std::array<uint8_t, 13> data{0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD,
+                                 0xEF, 0x10, 0x32, 0x54, 0x76, 0x98};
+    std::string hex;
+    for (size_t size : {3, 13})
+    {
+        runBenchmark(results, "toHexStr/" + std::to_string(size), 1000000,
+                     [&](size_t i) {
+                         data[0] = static_cast<uint8_t>(i);
+                         toHexStr(std::span(data).first(size), hex);
+                         keep(hex.data());
+                     });
+    }
+
+    // Everything a threshold record goes through before sd_journal_sendv(),
+    // which is expected not to allocate once warmed up
+    std::string path = "/xyz/openbmc_project/sensors/temperature/CPU1_Temp";
+    runBenchmark(results, "formatThresholdRecord", 1000000, [&](size_t i) {
+        double reading = 90.0 + static_cast<double>(i % 100) / 10;
+        SelMessageBuffer message;
+        message.append("CPU1_Temp")
+            .append(" critical high threshold assert. Reading=")
+            .append(reading)
+            .append(" Threshold=")
+            .append(95.0)
+            .append('.');
+        SelJournalField<"IPMI_SEL_RECORD_ID", 5> recordIdField;
+        recordIdField.append(i % 65534 + 1);
+        SelJournalField<"IPMI_SEL_GENERATOR_ID", 4> genIdField;
+        genIdField.append(0x20, 16);
+        SelJournalField<"IPMI_SEL_EVENT_DIR", 1> eventDirField;
+        eventDirField.append(true);
+        SelJournalField<"IPMI_SEL_DATA", 6> selDataField;
+        selDataField.appendHex(std::span(data).first(3));
+        SelJournalField<"REDFISH_MESSAGE_ARGS", 256> redfishMessageArgs;
+        redfishMessageArgs.append("CPU1_Temp")
+            .append(',')
+            .append(reading)
+            .append(',')
+            .append(95.0);
+        std::array<iovec, 7> iov{
+            selJournalIovec(selJournalTextField<"MESSAGE">(message.view())),
+            selJournalIovec(recordIdField),
+            selJournalIovec(genIdField),
+            selJournalIovec(eventDirField),
+            selJournalIovec(selDataField),
+            selJournalIovec(
+                selJournalTextField<"IPMI_SEL_SENSOR_PATH">(path)),
+            selJournalIovec(redfishMessageArgs)};
+        keep(iov);
+    });
+}
+
+void benchmarkRecordIds(std::vector<BenchmarkResult>& results,
+                        const std::filesystem::path& dir)
+{
+    RecordIdBitmap bitmap(dir / "next_records.bitmap");
+    bitmap.open();
+    // Steady state: an ID is given out and an older one deleted
+    runBenchmark(results, "getNewRecordId/allocateFree", 1000000,
+                 [&bitmap](size_t) {
+                     uint16_t recordId = bitmap.allocate();
+                     bitmap.free(recordId);
+                     keep(recordId);
+                 });
+    // A SEL filling up from empty, cleared whenever it is full
+    bitmap.clear();
+    runBenchmark(results, "getNewRecordId/fill", 1000000, [&bitmap](size_t) {
+        uint16_t recordId = bitmap.allocate();
+        if (recordId == RecordIdBitmap::invalidId)
+        {
+            bitmap.clear();
+            recordId = bitmap.allocate();
+        }
+        keep(recordId);
+    });
+    runBenchmark(results, "getFreeRecordIds", 10000,
+                 [&bitmap](size_t) { keep(bitmap.freeCount()); });
+}
+
+// Write an ipmi_sel file of lines records in the format rsyslog writes
+void generateSelLog(const std::filesystem::path& file, size_t lines)
+{
+    std::ofstream stream(file, std::ios::trunc);
+    for (size_t i = 0; i < lines; i++)
+    {
+        std::array<uint8_t, 3> data{0xC1, static_cast<uint8_t>(i), 0xFF};
+        SelMessageBuffer buffer;
+        buffer.append("2026-01-01T00:00:00.000000+00:00 ")
+            .append(i % (selInvalidRecordId - 1) + 1)
+            .append(",2,")
+            .appendHex(data)
+            .append(",20,/xyz/openbmc_project/sensors/temperature/Sensor")
+            .append(i % 64)
+            .append(",1\n");
+        stream << buffer.view();
+    }
+}
+
+void benchmarkLogFiles(std::vector<BenchmarkResult>& results,
+                       const std::filesystem::path& dir, size_t maxLines)
+{
+    for (size_t lines = 1000; lines <= maxLines; lines *= 10)
+    {
+        std::filesystem::path logDir = dir / std::to_string(lines);
+        std::filesystem::create_directories(logDir);
+        std::filesystem::path logFile = logDir / "ipmi_sel";
+        generateSelLog(logFile, lines);
+        std::string suffix = "/" + std::to_string(lines);
+        size_t rebuilds = lines >= 100000 ? 3 : 20;
+
+        // Finding the newest record ID when record IDs aren't reused, among
+        // as many records as the default writer thread settings can reorder
+        runBenchmark(results, "initializeRecordId/tail" + suffix, 1000,
+                     [&logFile](size_t) {
+                         size_t count = 1024 + 64;
+                         keep(readHighestSelRecordId(logFile, count));
+                     });
+        // Indexing every record when they are
+        runBenchmark(results, "initializeRecordId/index" + suffix, rebuilds,
+                     [&logDir](size_t) {
+                         SelLogIndex index(logDir, "ipmi_sel");
+                         index.refresh();
+                         keep(index.size());
+                     });
+
+        // Each deletion removes a different record, working back from the
+        // newest, which is how the files are rewritten the least
+        SelLogIndex index(logDir, "ipmi_sel");
+        index.refresh();
+        size_t recordIds = std::min<size_t>(lines, selInvalidRecordId - 1);
+        runBenchmark(results, "selDeleteTargetRecord" + suffix,
+                     std::min<size_t>(rebuilds * 5, recordIds / 2),
+                     [&index, recordIds](size_t i) {
+                         keep(index.remove(
+                             static_cast<uint16_t>(recordIds - i)));
+                     });
+
+        std::filesystem::remove_all(logDir);
+    }
+}
+
+void printJson(const std::vector<BenchmarkResult>& results)
+{
+    std::cout << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& result = results[i];
+        std::cout << (i == 0 ? "\n" : ",\n") << "    {\"name\": \""
+                  << result.name << "\", \"iterations\": " << result.iterations
+                  << ", \"ns_per_op\": " << result.nsPerOp
+                  << ", \"allocations_per_op\": " << result.allocationsPerOp
+                  << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t maxLines = 1000000;
+    std::filesystem::path dir;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--max-lines")
+        {
+            maxLines = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (arg == "--dir")
+        {
+            dir = argv[i + 1];
+        }
+        else
+        {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    bool ownDir = dir.empty();
+    if (ownDir)
+    {
+        std::string tmpDir = (std::filesystem::temp_directory_path() /
+                              "sel-logger-benchmark-XXXXXX")
+                                 .string();
+        if (mkdtemp(tmpDir.data()) == nullptr)
+        {
+            std::cerr << "Failed to create a directory for the benchmark\n";
+            return EXIT_FAILURE;
+        }
+        dir = tmpDir;
+    }
+    std::filesystem::create_directories(dir);
+
+    std::vector<BenchmarkResult> results;
+    benchmarkScaling(results);
+    benchmarkFormatting(results);
+    benchmarkRecordIds(results, dir);
+    benchmarkLogFiles(results, dir, maxLines);
+    printJson(results);
+
+    if (ownDir)
+    {
+        std::filesystem::remove_all(dir);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Kinds of event the monitors track the assertion state of, one bit each
+enum class AssertedEvent : uint8_t
+{
+    warningLow = 1 << 0,
+    warningHigh = 1 << 1,
+    criticalLow = 1 << 2,
+    criticalHigh = 1 << 3,
+    hostError = 1 << 4,
+};
+
+/** @class AssertedEventTracker
+ *  @brief Which events are currently asserted on each D-Bus object
+ *  @details Every object path is interned once into a small integer ID, and
+ *  the state of an object is a bitmask of AssertedEvent indexed by that ID,
+ *  so checking or changing the state is a hash lookup and a bit operation.
+ */
+class AssertedEventTracker
+{
+  public:
+    using PathId = uint32_t;
+
+    // Mark an event asserted, returns false if it already was
+    bool setAsserted(std::string_view path, AssertedEvent event)
+    {
+        uint8_t& state = states[intern(path)];
+        if (state & static_cast<uint8_t>(event))
+        {
+            return false;
+        }
+        state |= static_cast<uint8_t>(event);
+        changed();
+        return true;
+    }
+
+    // Mark an event deasserted, returns false if it wasn't asserted
+    bool setDeasserted(std::string_view path, AssertedEvent event)
+    {
+        // Don't intern paths that have never had anything asserted
+        auto findPath = ids.find(path);
+        if (findPath == ids.end())
+        {
+            return false;
+        }
+        uint8_t& state = states[findPath->second];
+        if (!(state & static_cast<uint8_t>(event)))
+        {
+            return false;
+        }
+        state &= ~static_cast<uint8_t>(event);
+        changed();
+        return true;
+    }
+
+    bool isAsserted(std::string_view path, AssertedEvent event) const
+    {
+        auto findPath = ids.find(path);
+        return findPath != ids.end() &&
+               (states[findPath->second] & static_cast<uint8_t>(event));
+    }
+
+    // Called whenever the state of any path changes
+    void setOnChange(std::function<void()>&& handler)
+    {
+        onChange = std::move(handler);
+    }
+
+    // Write the asserted events to a file, one "<bitmask> <path>" per line.
+    // The file is replaced atomically so a crash can't leave it truncated.
+    bool save(const std::filesystem::path& file) const
+    {
+        std::filesystem::path tmpFile = file;
+        tmpFile += ".tmp";
+        {
+            std::ofstream stream(tmpFile, std::ios::trunc);
+            for (size_t id = 0; id < paths.size(); id++)
+            {
+                if (states[id] != 0)
+                {
+                    stream << static_cast<unsigned int>(states[id]) << ' '
+                           << paths[id] << '\n';
+                }
+            }
+            if (!stream.flush())
+            {
+                return false;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmpFile, file, ec);
+        return !ec;
+    }
+
+    // Restore the asserted events written by save(), returns false if there
+    // was no file to restore from
+    bool load(const std::filesystem::path& file)
+    {
+        std::ifstream stream(file);
+        if (!stream.is_open())
+        {
+            return false;
+        }
+        std::string line;
+        while (std::getline(stream, line))
+        {
+            uint8_t state = 0;
+            auto [ptr, ec] =
+                std::from_chars(line.data(), line.data() + line.size(), state);
+            if (ec != std::errc() || ptr == line.data() + line.size() ||
+                *ptr != ' ')
+            {
+                continue;
+            }
+            std::string_view path(ptr + 1, line.data() + line.size() - ptr - 1);
+            states[intern(path)] |= state;
+        }
+        return true;
+    }
+
+    PathId intern(std::string_view path)
+    {
+        auto findPath = ids.find(path);
+        if (findPath != ids.end())
+        {
+            return findPath->second;
+        }
+        PathId id = static_cast<PathId>(paths.size());
+        auto [inserted, unused] = ids.emplace(std::string(path), id);
+        // The map's keys never move, so they can be referred to by ID
+        paths.emplace_back(inserted->first);
+        states.push_back(0);
+        return id;
+    }
+
+  private:
+    // Allows looking up a std::string key with a std::string_view
+    struct PathHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view path) const
+        {
+            return std::hash<std::string_view>{}(path);
+        }
+    };
+
+    void changed() const
+    {
+        if (onChange)
+        {
+            onChange();
+        }
+    }
+
+    std::unordered_map<std::string, PathId, PathHash, std::equal_to<>> ids;
+    std::vector<std::string_view> paths;
+    std::vector<uint8_t> states;
+    std::function<void()> onChange;
+};
+
+// Shared by all of the monitors, so each path is only stored once
+inline AssertedEventTracker& getAssertedEvents()
+{
+    static AssertedEventTracker assertedEvents;
+    return assertedEvents;
+}
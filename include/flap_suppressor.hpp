@@ -0,0 +1,254 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/container/flat_map.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sel_logger.hpp>
+#include <sel_metrics.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct FlapSuppressionConfig
+{
+    // Transitions a sensor may log back to back, 0 disables suppression
+    unsigned int burst = 0;
+    // Time to earn back one transition
+    std::chrono::seconds refillPeriod{0};
+    // Time without transitions that ends a storm
+    std::chrono::seconds quietPeriod{0};
+};
+
+#ifdef SEL_LOGGER_FLAP_SUPPRESSION
+static constexpr FlapSuppressionConfig flapSuppressionConfig{
+    SEL_LOGGER_FLAP_BURST, std::chrono::seconds(SEL_LOGGER_FLAP_REFILL_SECONDS),
+    std::chrono::seconds(SEL_LOGGER_FLAP_QUIET_SECONDS)};
+#else
+static constexpr FlapSuppressionConfig flapSuppressionConfig{};
+#endif
+
+/** @class FlapSuppressor
+ *  @brief Per-sensor token bucket that limits how fast threshold transitions
+ *  are logged
+ *  @details Each logged transition uses a token, and tokens are earned back
+ *  one per refill period up to the burst size.  A sensor that runs out is in
+ *  a storm: every transition is held back, however many tokens it earns,
+ *  until none have arrived for the quiet period.  The storm then ends by
+ *  logging the last held back transition of each threshold whose state
+ *  differs from the last one logged, so the SEL ends up showing the sensor's
+ *  real state, and a journal entry counting the rest.  That entry is not a
+ *  SEL record, since it is about no one threshold.
+ */
+class FlapSuppressor
+{
+  public:
+    FlapSuppressor(boost::asio::io_context& io,
+                   std::shared_ptr<sdbusplus::asio::connection> conn,
+                   const FlapSuppressionConfig& config) :
+        io(io), conn(conn), config(config)
+    {}
+
+    FlapSuppressor(const FlapSuppressor&) = delete;
+    FlapSuppressor& operator=(const FlapSuppressor&) = delete;
+
+    // Log a transition of the threshold event on the sensor at path by
+    // calling log, now or when the storm it is part of ends
+    void submit(const std::string& path, std::string_view event, bool assert,
+                std::function<void()>&& log)
+    {
+        if (config.burst == 0)
+        {
+            log();
+            return;
+        }
+
+        Sensor& sensor = getSensor(path);
+        Clock::time_point now = Clock::now();
+        if (!sensor.storm)
+        {
+            refill(sensor, now);
+            if (sensor.tokens > 0)
+            {
+                sensor.tokens--;
+                sensor.logged.insert_or_assign(std::string(event), assert);
+                log();
+                return;
+            }
+            sensor.storm = true;
+            sensor.stormStart = now;
+            sensor.held = 0;
+        }
+
+        // A transition is only counted as suppressed once it is known not to
+        // be logged at the end of the storm
+        sensor.held++;
+        auto [findPending, inserted] = sensor.pending.try_emplace(
+            std::string(event), Pending{assert, selMetricsEvent, nullptr});
+        if (!inserted)
+        {
+            selMetricsSuppressed(findPending->second.event);
+            findPending->second.assert = assert;
+            findPending->second.event = selMetricsEvent;
+        }
+        findPending->second.log = std::move(log);
+        // Every transition in the storm pushes its end back
+        sensor.quietTimer->expires_after(config.quietPeriod);
+        sensor.quietTimer->async_wait(
+            [this, path](const boost::system::error_code& ec) {
+                if (ec)
+                {
+                    return;
+                }
+                endStorm(path);
+            });
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending
+    {
+        bool assert;
+        // The event the transition is counted against
+        std::optional<SelMetricsEvent> event;
+        std::function<void()> log;
+    };
+
+    struct Sensor
+    {
+        unsigned int tokens = 0;
+        Clock::time_point lastRefill;
+        bool storm = false;
+        Clock::time_point stormStart;
+        // Transitions held back in the storm
+        size_t held = 0;
+        // Last logged state of each threshold event
+        boost::container::flat_map<std::string, bool> logged;
+        // Last suppressed transition of each threshold event
+        boost::container::flat_map<std::string, Pending> pending;
+        std::unique_ptr<boost::asio::steady_timer> quietTimer;
+    };
+
+    Sensor& getSensor(const std::string& path)
+    {
+        auto [it, inserted] = sensors.try_emplace(path);
+        if (inserted)
+        {
+            it->second.tokens = config.burst;
+            it->second.lastRefill = Clock::now();
+            it->second.quietTimer =
+                std::make_unique<boost::asio::steady_timer>(io);
+        }
+        return it->second;
+    }
+
+    void refill(Sensor& sensor, Clock::time_point now)
+    {
+        auto earned = (now - sensor.lastRefill) / config.refillPeriod;
+        if (earned <= 0)
+        {
+            return;
+        }
+        sensor.tokens = static_cast<unsigned int>(std::min<decltype(earned)>(
+            sensor.tokens + earned, config.burst));
+        sensor.lastRefill += earned * config.refillPeriod;
+        if (sensor.tokens == config.burst)
+        {
+            sensor.lastRefill = now;
+        }
+    }
+
+    void endStorm(const std::string& path)
+    {
+        auto findSensor = sensors.find(path);
+        if (findSensor == sensors.end())
+        {
+            return;
+        }
+        Sensor& sensor = findSensor->second;
+        Clock::time_point now = Clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::seconds>(
+            now - sensor.stormStart);
+
+        // Take the pending transitions first, logging may submit again
+        boost::container::flat_map<std::string, Pending> pending;
+        pending.swap(sensor.pending);
+        size_t suppressed = sensor.held;
+        sensor.storm = false;
+        sensor.held = 0;
+        sensor.tokens = config.burst;
+        sensor.lastRefill = now;
+
+        std::vector<std::function<void()>> logs;
+        for (auto& [event, transition] : pending)
+        {
+            auto findLogged = sensor.logged.find(event);
+            if (findLogged != sensor.logged.end() &&
+                findLogged->second == transition.assert)
+            {
+                selMetricsSuppressed(transition.event);
+                continue;
+            }
+            sensor.logged.insert_or_assign(event, transition.assert);
+            logs.emplace_back(std::move(transition.log));
+        }
+        suppressed -= logs.size();
+
+        if (suppressed != 0)
+        {
+            std::string_view sensorName(path);
+            sensorName.remove_prefix(std::min(sensorName.find_last_of('/') + 1,
+                                              sensorName.size()));
+            SelMessageBuffer message;
+            message.append(sensorName)
+                .append(' ')
+                .append(suppressed)
+                .append(" threshold transitions suppressed in ")
+                .append(duration.count())
+                .append(" seconds");
+#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+            createLogEntry(
+                conn, std::string(message.view()),
+                "xyz.openbmc_project.Logging.Entry.Level.Informational",
+                {{"SENSOR_PATH", path}});
+#else
+            selJournalSend(selJournalTextField<"MESSAGE">(message.view()),
+                           selJournalTextField<"SENSOR_PATH">(path));
+#endif
+        }
+
+        for (std::function<void()>& log : logs)
+        {
+            log();
+        }
+    }
+
+    boost::asio::io_context& io;
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    FlapSuppressionConfig config;
+    // Not a flat_map, so a Sensor stays put while a transition is logged
+    std::unordered_map<std::string, Sensor> sensors;
+};
@@ -15,19 +15,86 @@
 */
 
 #pragma once
+#include <asserted_events.hpp>
 #include <boost/container/flat_map.hpp>
-#include <boost/container/flat_set.hpp>
+#include <monitor_state_snapshot.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 #include <sel_logger.hpp>
+#include <sel_trace.hpp>
 #include <sensorutils.hpp>
 
+#include <string>
+#include <tuple>
+
 using sdbusMatch = std::shared_ptr<sdbusplus::match>;
 static sdbusMatch thermTripEventMatcher;
 static sdbusMatch ierrEventMatcher;
 
 static boost::container::flat_map<std::string, sdbusMatch> hostErrorMatches = {
     {"ThermalTrip", thermTripEventMatcher}, {"IERR", ierrEventMatcher}};
-static boost::container::flat_set<std::string> hostErrorEvents;
+
+static constexpr const char* hostErrorInterfacePrefix =
+    "xyz.openbmc_project.HostErrorMonitor.Processor.";
+
+inline static void logHostErrorEvent(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const std::string& objectPath, std::string_view msgInterface, bool assert)
+{
+    std::string_view eventName(objectPath);
+    eventName.remove_prefix(objectPath.find_last_of('/') + 1);
+    SelMessageBuffer message;
+    message.append(eventName).append(assert ? " Asserted" : " De-Asserted");
+    uint8_t selType = (msgInterface.ends_with("ThermalTrip")) ? 0x01 : 0x00;
+
+    SelEventData selData{selType, 0xff, 0xff};
+    // The offsets are those of the processor sensor type
+    selAddSystemRecord(
+        conn, message.view(), objectPath, selData, assert, selBMCGenID,
+        SelSensorInfo{selSensorTypeProcessor, selEventTypeSensorSpecific});
+}
+
+// A change of a host error's Asserted property, as it is traced
+struct HostErrorSignal
+{
+    static constexpr SelTraceKind traceKind = SelTraceKind::hostError;
+
+    std::string path;
+    std::string interface;
+    bool assert = false;
+
+    template <typename Self>
+    static auto traceFields(Self& self)
+    {
+        return std::tie(self.path, self.interface, self.assert);
+    }
+};
+
+inline static void handleHostError(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const HostErrorSignal& signal)
+{
+    SelMetricsScope metricsScope(SelMetricSource::hostError);
+    // Check if the log should be recorded.
+    AssertedEventTracker& assertedEvents = getAssertedEvents();
+    if (signal.assert)
+    {
+        if (!assertedEvents.setAsserted(signal.path, AssertedEvent::hostError))
+        {
+            selMetricsSuppressed();
+            return;
+        }
+    }
+    else
+    {
+        if (!assertedEvents.setDeasserted(signal.path,
+                                          AssertedEvent::hostError))
+        {
+            selMetricsSuppressed();
+            return;
+        }
+    }
+    logHostErrorEvent(conn, signal.path, signal.interface, signal.assert);
+}
 
 void hostErrorEventMonitor(std::shared_ptr<sdbusplus::asio::connection> conn,
                            sdbusplus::message_t& msg)
@@ -44,36 +111,15 @@ void hostErrorEventMonitor(std::shared_ptr<sdbusplus::asio::connection> conn,
                   << " ec= " << ec.what() << "\n";
         return;
     }
-    std::string objectPath = msg.get_path();
     auto findState = values.find("Asserted");
     if (values.empty() || findState == values.end())
     {
         return;
     }
-    bool assert = std::get<bool>(findState->second);
-    // Check if the log should be recorded.
-    if (assert)
-    {
-        if (hostErrorEvents.insert(objectPath).second == false)
-        {
-            return;
-        }
-    }
-    else
-    {
-        if (hostErrorEvents.erase(objectPath) == 0)
-        {
-            return;
-        }
-    }
-    std::string eventName = objectPath.substr(objectPath.find_last_of('/') + 1,
-                                              objectPath.length());
-    std::string message =
-        (assert) ? eventName + " Asserted" : eventName + " De-Asserted";
-    uint8_t selType = (msgInterface.ends_with("ThermalTrip")) ? 0x01 : 0x00;
-
-    std::vector<uint8_t> selData{selType, 0xff, 0xff};
-    selAddSystemRecord(conn, message, objectPath, selData, assert, selBMCGenID);
+    HostErrorSignal signal{msg.get_path(), msgInterface,
+                           std::get<bool>(findState->second)};
+    selTraceEvent(signal);
+    handleHostError(conn, signal);
 }
 
 inline static void startHostErrorEventMonitor(
@@ -85,11 +131,46 @@ inline static void startHostErrorEventMonitor(
         iter->second = std::make_shared<sdbusplus::match>(
             static_cast<sdbusplus::bus_t&>(*conn),
             "type='signal',interface='org.freedesktop.DBus.Properties',member='"
-            "PropertiesChanged',arg0namespace='xyz.openbmc_project."
-            "HostErrorMonitor.Processor." +
-                iter->first + "'",
+            "PropertiesChanged',arg0namespace='" +
+                std::string(hostErrorInterfacePrefix) + iter->first + "'",
             [conn, iter](sdbusplus::message_t& msg) {
                 hostErrorEventMonitor(conn, msg);
             });
     }
 }
+
+// After a restart, bring the restored asserted events up to date with the
+// current host errors, logging any assert or deassert that was missed while
+// the daemon was down
+inline static void reconcileHostErrorEvents(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const ManagedObjects& objects)
+{
+    AssertedEventTracker& assertedEvents = getAssertedEvents();
+    for (const auto& [objectPath, interfaces] : objects)
+    {
+        for (const auto& [name, match] : hostErrorMatches)
+        {
+            std::string interface = hostErrorInterfacePrefix + name;
+            std::optional<bool> asserted =
+                getManagedBool(interfaces, interface, "Asserted");
+            if (!asserted || *asserted == assertedEvents.isAsserted(
+                                              objectPath.str,
+                                              AssertedEvent::hostError))
+            {
+                continue;
+            }
+            if (*asserted)
+            {
+                assertedEvents.setAsserted(objectPath.str,
+                                           AssertedEvent::hostError);
+            }
+            else
+            {
+                assertedEvents.setDeasserted(objectPath.str,
+                                             AssertedEvent::hostError);
+            }
+            logHostErrorEvent(conn, objectPath.str, interface, *asserted);
+        }
+    }
+}
@@ -0,0 +1,291 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <asserted_events.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/container/flat_map.hpp>
+#include <boost/container/flat_set.hpp>
+#include <sdbusplus/asio/connection.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+// Kept in the service's runtime directory, which survives a restart of the
+// service but not a reboot of the BMC, when every alarm is raised again anyway
+static const std::filesystem::path assertedEventsSnapshotFile =
+    "/run/sel-logger/asserted_events";
+// How long to wait after a change before writing the snapshot, so a burst of
+// events only writes it once
+static constexpr std::chrono::seconds snapshotDelay(1);
+
+/** @class MonitorStateSnapshot
+ *  @brief Keeps a copy of the monitors' asserted events in a file so they
+ *  can pick up where they left off when the daemon is restarted
+ */
+class MonitorStateSnapshot
+{
+  public:
+    MonitorStateSnapshot(boost::asio::io_context& io,
+                         const std::filesystem::path& file) :
+        timer(io), file(file)
+    {}
+
+    MonitorStateSnapshot(const MonitorStateSnapshot&) = delete;
+    MonitorStateSnapshot& operator=(const MonitorStateSnapshot&) = delete;
+
+    // Restore the asserted events from the snapshot and write a new snapshot
+    // whenever they change.  Returns true if there was a snapshot to restore,
+    // meaning the daemon was restarted rather than started fresh.
+    bool start()
+    {
+        bool restored = getAssertedEvents().load(file);
+        if (!restored)
+        {
+            // Leave a snapshot even if nothing is ever asserted, so the next
+            // start still knows it is a restart
+            save();
+        }
+        getAssertedEvents().setOnChange([this]() { schedule(); });
+        return restored;
+    }
+
+  private:
+    void save()
+    {
+        std::error_code dirEc;
+        std::filesystem::create_directories(file.parent_path(), dirEc);
+        if (!getAssertedEvents().save(file))
+        {
+            std::cerr << "Failed to save asserted events to " << file << "\n";
+        }
+    }
+
+    void schedule()
+    {
+        if (pending)
+        {
+            return;
+        }
+        pending = true;
+        timer.expires_after(snapshotDelay);
+        timer.async_wait([this](const boost::system::error_code& ec) {
+            pending = false;
+            if (ec)
+            {
+                return;
+            }
+            save();
+        });
+    }
+
+    boost::asio::steady_timer timer;
+    std::filesystem::path file;
+    bool pending = false;
+};
+
+// Property values of the objects the monitors reconcile.  Properties of any
+// other type are skipped when the reply is read.
+using ManagedAssociations =
+    std::vector<std::tuple<std::string, std::string, std::string>>;
+using ManagedPropertyValue =
+    std::variant<std::string, bool, uint8_t, int16_t, uint16_t, int32_t,
+                 uint32_t, int64_t, uint64_t, double, std::vector<std::string>,
+                 ManagedAssociations>;
+using ManagedInterfaces = boost::container::flat_map<
+    std::string,
+    boost::container::flat_map<std::string, ManagedPropertyValue>>;
+using ManagedObjects =
+    boost::container::flat_map<sdbusplus::message::object_path,
+                               ManagedInterfaces>;
+
+// Get a numeric property as a double, if it is present and numeric
+inline std::optional<double> getManagedDouble(
+    const ManagedInterfaces& interfaces, const std::string& interface,
+    const std::string& property)
+{
+    auto findInterface = interfaces.find(interface);
+    if (findInterface == interfaces.end())
+    {
+        return std::nullopt;
+    }
+    auto findProperty = findInterface->second.find(property);
+    if (findProperty == findInterface->second.end())
+    {
+        return std::nullopt;
+    }
+    return std::visit(
+        [](const auto& value) -> std::optional<double> {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+            {
+                return static_cast<double>(value);
+            }
+            return std::nullopt;
+        },
+        findProperty->second);
+}
+
+inline std::optional<bool> getManagedBool(const ManagedInterfaces& interfaces,
+                                          const std::string& interface,
+                                          const std::string& property)
+{
+    auto findInterface = interfaces.find(interface);
+    if (findInterface == interfaces.end())
+    {
+        return std::nullopt;
+    }
+    auto findProperty = findInterface->second.find(property);
+    if (findProperty == findInterface->second.end())
+    {
+        return std::nullopt;
+    }
+    const bool* value = std::get_if<bool>(&findProperty->second);
+    if (value == nullptr)
+    {
+        return std::nullopt;
+    }
+    return *value;
+}
+
+// Whether an object is in the tree of an object manager at managerPath
+inline bool isManagedBy(std::string_view objectPath,
+                        std::string_view managerPath)
+{
+    if (managerPath == "/" || objectPath == managerPath)
+    {
+        return true;
+    }
+    return objectPath.starts_with(managerPath) &&
+           objectPath.size() > managerPath.size() &&
+           objectPath[managerPath.size()] == '/';
+}
+
+// Read every object implementing one of the interfaces, using one
+// GetManagedObjects call per object manager that covers them instead of a
+// call per object.  The handler is called once for each manager that answers.
+inline void getManagedObjects(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const std::vector<std::string>& interfaces,
+    std::function<void(const ManagedObjects&)>&& handler)
+{
+    static constexpr const char* objectManagerInterface =
+        "org.freedesktop.DBus.ObjectManager";
+    std::vector<std::string> subTreeInterfaces(interfaces);
+    subTreeInterfaces.emplace_back(objectManagerInterface);
+
+    using SubTree = boost::container::flat_map<
+        std::string, boost::container::flat_map<std::string,
+                                                std::vector<std::string>>>;
+    conn->async_method_call(
+        [conn, handler = std::move(handler)](boost::system::error_code ec,
+                                             const SubTree& subTree) {
+            if (ec)
+            {
+                std::cerr << "error getting objects to reconcile: "
+                          << ec.message() << "\n";
+                return;
+            }
+
+            // Find the objects of interest and the object managers of each
+            // service
+            using ServicePaths = boost::container::flat_map<
+                std::string, std::vector<std::string_view>>;
+            ServicePaths objects;
+            ServicePaths managerPaths;
+            for (const auto& [path, services] : subTree)
+            {
+                for (const auto& [service, serviceInterfaces] : services)
+                {
+                    if (serviceInterfaces.size() > 1 ||
+                        (serviceInterfaces.size() == 1 &&
+                         serviceInterfaces.front() != objectManagerInterface))
+                    {
+                        objects[service].emplace_back(path);
+                    }
+                    if (std::find(serviceInterfaces.begin(),
+                                  serviceInterfaces.end(),
+                                  objectManagerInterface) !=
+                        serviceInterfaces.end())
+                    {
+                        managerPaths[service].emplace_back(path);
+                    }
+                }
+            }
+
+            // Ask the manager closest to each object, so objects under
+            // different managers of one service are all read
+            boost::container::flat_set<std::pair<std::string, std::string>>
+                managers;
+            for (const auto& [service, servicePaths] : objects)
+            {
+                auto findManagers = managerPaths.find(service);
+                if (findManagers == managerPaths.end())
+                {
+                    continue;
+                }
+                for (std::string_view objectPath : servicePaths)
+                {
+                    std::string_view closest;
+                    for (std::string_view managerPath : findManagers->second)
+                    {
+                        if (managerPath.size() > closest.size() &&
+                            isManagedBy(objectPath, managerPath))
+                        {
+                            closest = managerPath;
+                        }
+                    }
+                    if (!closest.empty())
+                    {
+                        managers.emplace(service, closest);
+                    }
+                }
+            }
+
+            for (const auto& [service, manager] : managers)
+            {
+                conn->async_method_call(
+                    [handler, service, manager](
+                        boost::system::error_code ec,
+                        const ManagedObjects& managedObjects) {
+                        if (ec)
+                        {
+                            std::cerr << "error getting managed objects of "
+                                      << service << " at " << manager << ": "
+                                      << ec.message() << "\n";
+                            return;
+                        }
+                        handler(managedObjects);
+                    },
+                    service, manager, objectManagerInterface,
+                    "GetManagedObjects");
+            }
+        },
+        "xyz.openbmc_project.ObjectMapper",
+        "/xyz/openbmc_project/object_mapper",
+        "xyz.openbmc_project.ObjectMapper", "GetSubTree", "/", 0,
+        subTreeInterfaces);
+}
@@ -19,8 +19,70 @@
 #include <sdbusplus/asio/object_server.hpp>
 #include <sdbusplus/bus/match.hpp>
 #include <sel_logger.hpp>
+#include <sel_trace.hpp>
 #include <sensorutils.hpp>
 
+#include <string>
+#include <string_view>
+#include <tuple>
+
+// A change of a host's CurrentHostState, as it is traced
+struct HostStateSignal
+{
+    static constexpr SelTraceKind traceKind = SelTraceKind::hostState;
+
+    std::string path;
+    std::string hostState;
+
+    template <typename Self>
+    static auto traceFields(Self& self)
+    {
+        return std::tie(self.path, self.hostState);
+    }
+};
+
+inline static void handleHostStateChange(
+    [[maybe_unused]] const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const HostStateSignal& signal)
+{
+    SelMetricsScope metricsScope(SelMetricSource::pulse);
+    SelMessageBuffer journalMsg;
+    journalMsg.append("Host");
+    [[maybe_unused]] std::string_view redfishMsgId;
+    std::string_view hostObjPathPrefix = "/xyz/openbmc_project/state/host";
+
+    if (signal.path.starts_with(hostObjPathPrefix))
+    {
+        journalMsg.append(
+            std::string_view(signal.path).substr(hostObjPathPrefix.size()));
+    }
+
+    if (signal.hostState == "xyz.openbmc_project.State.Host.HostState.Off")
+    {
+        journalMsg.append(" state is off");
+        redfishMsgId = "REDFISH_MESSAGE_ID=OpenBMC.0.1.DCPowerOff";
+    }
+    else if (signal.hostState ==
+             "xyz.openbmc_project.State.Host.HostState.Running")
+    {
+        journalMsg.append(" state is on");
+        redfishMsgId = "REDFISH_MESSAGE_ID=OpenBMC.0.1.DCPowerOn";
+    }
+    else
+    {
+        return;
+    }
+#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+    createLogEntry(conn, std::string(journalMsg.view()),
+                   "xyz.openbmc_project.Logging.Entry.Level.Informational",
+                   {{"HOST_PATH", signal.path}});
+#else
+    selJournalSend(selJournalTextField<"MESSAGE">(journalMsg.view()),
+                   redfishMsgId);
+    selMetricsWritten();
+#endif
+}
+
 inline static sdbusplus::match startPulseEventMonitor(
     std::shared_ptr<sdbusplus::asio::connection> conn)
 {
@@ -29,7 +91,6 @@ inline static sdbusplus::match startPulseEventMonitor(
         boost::container::flat_map<std::string, std::variant<std::string>>
             propertiesChanged;
         msg.read(thresholdInterface, propertiesChanged);
-        std::string objPath = msg.get_path();
 
         if (propertiesChanged.empty())
         {
@@ -48,49 +109,9 @@ inline static sdbusplus::match startPulseEventMonitor(
 
         if (event == "CurrentHostState")
         {
-            std::string journalMsg = "Host";
-            std::string redfishMsgId;
-            std::string_view hostObjPathPrefix =
-                "/xyz/openbmc_project/state/host";
-
-            if (objPath.starts_with(hostObjPathPrefix))
-            {
-                journalMsg += objPath.erase(0, hostObjPathPrefix.size());
-            }
-
-            if (*variant == "xyz.openbmc_project.State.Host.HostState.Off")
-            {
-                journalMsg += " state is off";
-                redfishMsgId = "OpenBMC.0.1.DCPowerOff";
-            }
-            else if (*variant ==
-                     "xyz.openbmc_project.State.Host.HostState.Running")
-            {
-                journalMsg += " state is on";
-                redfishMsgId = "OpenBMC.0.1.DCPowerOn";
-            }
-            else
-            {
-                return;
-            }
-#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
-            sdbusplus::message_t newLogEntry = conn->new_method_call(
-                "xyz.openbmc_project.Logging", "/xyz/openbmc_project/logging",
-                "xyz.openbmc_project.Logging.Create", "Create");
-            const std::string logLevel =
-                "xyz.openbmc_project.Logging.Entry.Level.Informational";
-            const std::string hostPathName = "HOST_PATH";
-            const std::string hostPath = msg.get_path();
-            newLogEntry.append(
-                std::move(journalMsg), std::move(logLevel),
-                std::map<std::string, std::string>(
-                    {{std::move(hostPathName), std::move(hostPath)}}));
-            conn->call(newLogEntry);
-#else
-            sd_journal_send("MESSAGE=%s", journalMsg.c_str(),
-                            "REDFISH_MESSAGE_ID=%s", redfishMsgId.c_str(),
-                            NULL);
-#endif
+            HostStateSignal signal{msg.get_path(), *variant};
+            selTraceEvent(signal);
+            handleHostStateChange(conn, signal);
         }
     };
 
@@ -0,0 +1,210 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+/** @class RecordIdBitmap
+ *  @brief Allocator for SEL record IDs backed by a memory-mapped bitmap
+ *  @details One bit per possible record ID (8 KiB in total), set while the ID
+ *  is in use.  The file is updated in place through the mapping, so giving
+ *  out or freeing an ID never rewrites the file.  IDs are handed out lowest
+ *  first; ID 0 and 0xFFFF are never handed out, and 0xFFFF is returned once
+ *  every other ID is in use.
+ */
+class RecordIdBitmap
+{
+  public:
+    static constexpr uint16_t invalidId = std::numeric_limits<uint16_t>::max();
+
+    explicit RecordIdBitmap(const std::filesystem::path& file) : file(file) {}
+
+    ~RecordIdBitmap()
+    {
+        if (words != nullptr)
+        {
+            munmap(words, bitmapSize);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    RecordIdBitmap(const RecordIdBitmap&) = delete;
+    RecordIdBitmap& operator=(const RecordIdBitmap&) = delete;
+
+    // Map the bitmap file, creating it if needed.  Returns true if the file
+    // was newly created, so the caller can fill it in.
+    bool open()
+    {
+        fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "Failed to open " << file << ": " << strerror(errno)
+                      << "\n";
+            return false;
+        }
+        struct stat st{};
+        bool created = fstat(fd, &st) < 0 ||
+                       static_cast<size_t>(st.st_size) != bitmapSize;
+        if (created && ftruncate(fd, bitmapSize) < 0)
+        {
+            std::cerr << "Failed to size " << file << ": " << strerror(errno)
+                      << "\n";
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        void* map = mmap(nullptr, bitmapSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            std::cerr << "Failed to map " << file << ": " << strerror(errno)
+                      << "\n";
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        words = static_cast<uint64_t*>(map);
+        if (created)
+        {
+            clear();
+        }
+        reserveInvalidIds();
+        hint = 0;
+        return created;
+    }
+
+    bool isOpen() const
+    {
+        return words != nullptr;
+    }
+
+    // Get the lowest free ID and mark it in use, or invalidId if none is left
+    uint16_t allocate()
+    {
+        if (!isOpen())
+        {
+            return invalidId;
+        }
+        for (; hint < wordCount; hint++)
+        {
+            uint64_t freeBits = ~words[hint];
+            if (freeBits != 0)
+            {
+                size_t bit = std::countr_zero(freeBits);
+                words[hint] |= uint64_t{1} << bit;
+                return static_cast<uint16_t>(hint * wordBits + bit);
+            }
+        }
+        return invalidId;
+    }
+
+    void free(uint16_t recordId)
+    {
+        if (!isOpen() || recordId == 0 || recordId == invalidId)
+        {
+            return;
+        }
+        size_t word = recordId / wordBits;
+        words[word] &= ~(uint64_t{1} << (recordId % wordBits));
+        hint = std::min(hint, word);
+    }
+
+    // Number of IDs that can still be handed out
+    size_t freeCount() const
+    {
+        if (!isOpen())
+        {
+            return 0;
+        }
+        size_t used = 0;
+        for (size_t word = 0; word < wordCount; word++)
+        {
+            used += std::popcount(words[word]);
+        }
+        return wordCount * wordBits - used;
+    }
+
+    // Mark every ID below recordId as in use
+    void reserveBelow(uint16_t recordId)
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        size_t word = recordId / wordBits;
+        std::memset(static_cast<void*>(words), 0xFF, word * sizeof(uint64_t));
+        if (recordId % wordBits != 0)
+        {
+            words[word] |= (uint64_t{1} << (recordId % wordBits)) - 1;
+        }
+    }
+
+    // Free every ID
+    void clear()
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        std::memset(static_cast<void*>(words), 0, bitmapSize);
+        reserveInvalidIds();
+        hint = 0;
+        msync(words, bitmapSize, MS_ASYNC);
+    }
+
+    // Write the allocator state out to the file and wait for it.  May be
+    // called from another thread than the one allocating IDs.
+    void sync()
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        msync(words, bitmapSize, MS_SYNC);
+    }
+
+  private:
+    static constexpr size_t wordBits = 64;
+    static constexpr size_t wordCount = 65536 / wordBits;
+    static constexpr size_t bitmapSize = wordCount * sizeof(uint64_t);
+
+    void reserveInvalidIds()
+    {
+        words[0] |= 1;
+        words[wordCount - 1] |= uint64_t{1} << (wordBits - 1);
+    }
+
+    std::filesystem::path file;
+    int fd = -1;
+    uint64_t* words = nullptr;
+    // Every word before this one is known to be full
+    size_t hint = 0;
+};
@@ -0,0 +1,307 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <vector>
+
+static constexpr size_t selRecordSize = 16;
+static constexpr uint8_t selEvmRev = 0x04;
+static constexpr uint8_t selEventDirDeassert = 0x80;
+static constexpr uint8_t selUnknownSensor = 0xFF;
+// Timestamped OEM records are 0xC0-0xDF, non-timestamped are 0xE0-0xFF
+static constexpr uint8_t selOemTimestampedFirst = 0xC0;
+static constexpr uint8_t selOemNonTimestampedFirst = 0xE0;
+
+using SelRecord = std::array<uint8_t, selRecordSize>;
+
+/** @class SelBinaryStore
+ *  @brief Ring of 16-byte IPMI SEL records in a memory-mapped file
+ *  @details The file is a small header followed by a fixed number of record
+ *  slots.  Adding a record is a copy into the mapping, so the daemon never
+ *  formats text for this store and leaves write-back to the kernel.  When the
+ *  ring is full the oldest record is overwritten, and if asked to, its ID is
+ *  kept for the caller to free.  A slot whose record type is 0 is empty (never written or
+ *  deleted).
+ *
+ *  Sensor numbers are assigned by the IPMI SDR, which this daemon can't see,
+ *  so they are written as 0xFF.
+ */
+class SelBinaryStore
+{
+  public:
+    SelBinaryStore(const std::filesystem::path& file, uint32_t capacity,
+                   bool keepOverwrittenIds = false) :
+        capacity(capacity), keepOverwrittenIds(keepOverwrittenIds)
+    {
+        fd = open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "Failed to open " << file << ": " << strerror(errno)
+                      << "\n";
+            return;
+        }
+
+        struct stat st{};
+        size_t fileSize = sizeof(Header) + capacity * selRecordSize;
+        bool resized = fstat(fd, &st) < 0 ||
+                       static_cast<size_t>(st.st_size) != fileSize;
+        if (resized && ftruncate(fd, fileSize) < 0)
+        {
+            std::cerr << "Failed to size " << file << ": " << strerror(errno)
+                      << "\n";
+            close(fd);
+            fd = -1;
+            return;
+        }
+
+        void* map =
+            mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            std::cerr << "Failed to map " << file << ": " << strerror(errno)
+                      << "\n";
+            close(fd);
+            fd = -1;
+            return;
+        }
+        mappedSize = fileSize;
+        header = static_cast<Header*>(map);
+        records = reinterpret_cast<SelRecord*>(header + 1);
+
+        if (header->magic != storeMagic || header->version != storeVersion ||
+            header->recordSize != selRecordSize ||
+            header->capacity != capacity || header->head >= capacity ||
+            header->count > capacity)
+        {
+            if (!resized)
+            {
+                std::cerr << "Reinitializing incompatible SEL store " << file
+                          << "\n";
+            }
+            clear();
+        }
+    }
+
+    ~SelBinaryStore()
+    {
+        if (header != nullptr)
+        {
+            munmap(header, mappedSize);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    SelBinaryStore(const SelBinaryStore&) = delete;
+    SelBinaryStore& operator=(const SelBinaryStore&) = delete;
+
+    bool isOpen() const
+    {
+        return header != nullptr;
+    }
+
+    void addSystemRecord(uint16_t recordId, uint16_t genId, uint8_t sensorType,
+                         uint8_t eventType, bool assert,
+                         std::span<const uint8_t> eventData)
+    {
+        SelRecord record;
+        record.fill(selUnknownSensor);
+        putRecordHeader(record, recordId, selSystemTypeId);
+        putTimestamp(record, 3);
+        record[7] = static_cast<uint8_t>(genId);
+        record[8] = static_cast<uint8_t>(genId >> 8);
+        record[9] = selEvmRev;
+        record[10] = sensorType;
+        // record[11] is the unknown sensor number
+        record[12] = eventType | (assert ? 0 : selEventDirDeassert);
+        std::copy_n(eventData.begin(), std::min<size_t>(eventData.size(), 3),
+                    record.begin() + 13);
+        append(record);
+    }
+
+    void addOemRecord(uint16_t recordId, uint8_t recordType,
+                      std::span<const uint8_t> data)
+    {
+        SelRecord record{};
+        putRecordHeader(record, recordId, recordType);
+        size_t offset = 3;
+        if (recordType >= selOemTimestampedFirst &&
+            recordType < selOemNonTimestampedFirst)
+        {
+            putTimestamp(record, offset);
+            offset += 4;
+        }
+        std::copy_n(data.begin(),
+                    std::min<size_t>(data.size(), selRecordSize - offset),
+                    record.begin() + offset);
+        append(record);
+    }
+
+    // Mark the slot holding recordId as empty, returns false if not found
+    bool deleteRecord(uint16_t recordId)
+    {
+        if (!isOpen())
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < capacity; i++)
+        {
+            SelRecord& record = records[i];
+            if (record[2] != 0 && getRecordId(record) == recordId)
+            {
+                record.fill(0);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void clear()
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        std::memset(static_cast<void*>(records), 0, capacity * selRecordSize);
+        *header = Header{};
+        header->magic = storeMagic;
+        header->version = storeVersion;
+        header->recordSize = selRecordSize;
+        header->capacity = capacity;
+        msync(header, mappedSize, MS_ASYNC);
+        std::lock_guard lock(overwrittenMutex);
+        overwrittenIds.clear();
+    }
+
+    // Write the records added so far out to the file and wait for it
+    void sync()
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        msync(header, mappedSize, MS_SYNC);
+    }
+
+    // Take the IDs of the records the ring has overwritten since the last
+    // call.  May be called from another thread than the one adding records.
+    std::vector<uint16_t> takeOverwrittenIds()
+    {
+        std::lock_guard lock(overwrittenMutex);
+        std::vector<uint16_t> recordIds;
+        recordIds.swap(overwrittenIds);
+        return recordIds;
+    }
+
+    // The highest ID added since the last clear, or 0 if the store is empty.
+    // Not necessarily the ID of the last record added, since the writer
+    // thread may write a critical record ahead of older ones.
+    uint16_t highestRecordId() const
+    {
+        if (!isOpen() || header->count == 0)
+        {
+            return 0;
+        }
+        return header->highestRecordId;
+    }
+
+  private:
+    static constexpr uint32_t storeMagic = 0x424c4553; // "SELB"
+    static constexpr uint16_t storeVersion = 1;
+    static constexpr uint8_t selSystemTypeId = 0x02;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t recordSize;
+        uint32_t capacity;
+        // Slot the next record is written to
+        uint32_t head;
+        // Number of slots written since the last clear, up to capacity
+        uint32_t count;
+        uint16_t highestRecordId;
+        uint8_t reserved[10];
+    };
+    static_assert(sizeof(Header) % selRecordSize == 0);
+
+    static void putRecordHeader(SelRecord& record, uint16_t recordId,
+                                uint8_t recordType)
+    {
+        // IPMI SEL records are little-endian
+        record[0] = static_cast<uint8_t>(recordId);
+        record[1] = static_cast<uint8_t>(recordId >> 8);
+        record[2] = recordType;
+    }
+
+    static void putTimestamp(SelRecord& record, size_t offset)
+    {
+        auto timestamp = static_cast<uint32_t>(std::time(nullptr));
+        for (size_t i = 0; i < 4; i++)
+        {
+            record[offset + i] = static_cast<uint8_t>(timestamp >> (8 * i));
+        }
+    }
+
+    static uint16_t getRecordId(const SelRecord& record)
+    {
+        return static_cast<uint16_t>(record[0] | (record[1] << 8));
+    }
+
+    void append(const SelRecord& record)
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        SelRecord& slot = records[header->head];
+        if (keepOverwrittenIds && slot[2] != 0)
+        {
+            std::lock_guard lock(overwrittenMutex);
+            overwrittenIds.push_back(getRecordId(slot));
+        }
+        slot = record;
+        header->head = (header->head + 1) % capacity;
+        header->count = std::min(header->count + 1, capacity);
+        header->highestRecordId =
+            std::max(header->highestRecordId, getRecordId(record));
+    }
+
+    uint32_t capacity;
+    bool keepOverwrittenIds;
+    int fd = -1;
+    size_t mappedSize = 0;
+    Header* header = nullptr;
+    SelRecord* records = nullptr;
+    std::mutex overwrittenMutex;
+    std::vector<uint16_t> overwrittenIds;
+};
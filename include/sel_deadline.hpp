@@ -0,0 +1,126 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+using SelDeadlineClock = std::chrono::steady_clock;
+
+struct SelDeadlineConfig
+{
+    // Longest a D-Bus call made to handle an event may take, 0 for the
+    // sdbusplus default of 25 seconds
+    std::chrono::milliseconds callTimeout{0};
+    // Longest an event may wait on D-Bus calls before it is logged without
+    // what they would have read, 0 for no limit
+    std::chrono::milliseconds eventDeadline{0};
+
+    // The call timeout as sdbusplus takes it, where 0 is its default
+    uint64_t callTimeoutUs() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   callTimeout)
+            .count();
+    }
+
+    // When an event starting now runs out of time
+    SelDeadlineClock::time_point eventExpiry() const
+    {
+        if (eventDeadline.count() == 0)
+        {
+            return SelDeadlineClock::time_point::max();
+        }
+        return SelDeadlineClock::now() + eventDeadline;
+    }
+};
+
+static constexpr SelDeadlineConfig selDeadlineConfig{
+    std::chrono::milliseconds(SEL_LOGGER_DBUS_CALL_TIMEOUT_MS),
+    std::chrono::milliseconds(SEL_LOGGER_EVENT_DEADLINE_MS)};
+
+/** @class SelEventDeadline
+ *  @brief Falls back if the D-Bus replies an event waits on don't come in time
+ *  @details Whichever comes first of the expiry and a claim() wins: at the
+ *  expiry the fallback is run, and a later claim() returns false so a late
+ *  reply isn't used to log the event a second time.
+ */
+class SelEventDeadline : public std::enable_shared_from_this<SelEventDeadline>
+{
+  public:
+    SelEventDeadline(boost::asio::io_context& io,
+                     std::function<void()>&& fallback) :
+        timer(io), fallback(std::move(fallback))
+    {}
+
+    SelEventDeadline(const SelEventDeadline&) = delete;
+    SelEventDeadline& operator=(const SelEventDeadline&) = delete;
+
+    // Run fallback at expiry unless claimed first.  An expiry of
+    // time_point::max() never comes.
+    static std::shared_ptr<SelEventDeadline> start(
+        boost::asio::io_context& io, SelDeadlineClock::time_point expiry,
+        std::function<void()>&& fallback)
+    {
+        auto deadline =
+            std::make_shared<SelEventDeadline>(io, std::move(fallback));
+        if (expiry != SelDeadlineClock::time_point::max())
+        {
+            deadline->timer.expires_at(expiry);
+            deadline->timer.async_wait(
+                [self = deadline->shared_from_this()](
+                    const boost::system::error_code& ec) {
+                    if (!ec && !self->claimed)
+                    {
+                        self->fallen = true;
+                        self->claimed = true;
+                        self->fallback();
+                    }
+                });
+        }
+        return deadline;
+    }
+
+    // Take over logging the event.  Returns false if the fallback already
+    // logged it.
+    bool claim()
+    {
+        if (claimed)
+        {
+            return false;
+        }
+        claimed = true;
+        timer.cancel();
+        return true;
+    }
+
+    // Whether the fallback has run
+    bool expired() const
+    {
+        return fallen;
+    }
+
+  private:
+    boost::asio::steady_timer timer;
+    std::function<void()> fallback;
+    bool claimed = false;
+    bool fallen = false;
+};
@@ -0,0 +1,174 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+// Two upper-case hex digits for every byte value
+static constexpr std::array<std::array<char, 2>, 256> selHexTable = []() {
+    constexpr std::string_view digits = "0123456789ABCDEF";
+    std::array<std::array<char, 2>, 256> table{};
+    for (size_t i = 0; i < table.size(); i++)
+    {
+        table[i] = {digits[i >> 4], digits[i & 0x0F]};
+    }
+    return table;
+}();
+
+// Write data as upper-case hex to out, which must have room for twice as many
+// characters as there are bytes.  Returns the end of the written characters.
+inline char* selHexEncode(std::span<const uint8_t> data, char* out)
+{
+    for (uint8_t byte : data)
+    {
+        out = std::copy_n(selHexTable[byte].begin(), 2, out);
+    }
+    return out;
+}
+
+inline void toHexStr(std::span<const uint8_t> data, std::string& hexStr)
+{
+    // Reuses the capacity hexStr already has
+    hexStr.resize(data.size() * 2);
+    selHexEncode(data, hexStr.data());
+}
+
+/** @class SelFormatBuffer
+ *  @brief Fixed-size text buffer for building log messages without allocating
+ *  @details Anything that doesn't fit is truncated.  The contents are always
+ *  NUL terminated so they can be passed to C APIs.
+ */
+template <size_t N>
+class SelFormatBuffer
+{
+  public:
+    SelFormatBuffer()
+    {
+        data[0] = '\0';
+    }
+
+    SelFormatBuffer& append(std::string_view text)
+    {
+        size_t count = std::min(text.size(), room());
+        std::copy_n(text.begin(), count, data.begin() + length);
+        length += count;
+        data[length] = '\0';
+        return *this;
+    }
+
+    SelFormatBuffer& append(char c)
+    {
+        return append(std::string_view(&c, 1));
+    }
+
+    // Formatted like std::to_string(bool), as 0 or 1.  A template so that
+    // string literals don't convert to bool.
+    template <std::same_as<bool> T>
+    SelFormatBuffer& append(T value)
+    {
+        return append(value ? '1' : '0');
+    }
+
+    // Hex digits are lower-case, like printf's %x
+    template <std::integral T>
+        requires(!std::same_as<T, bool>)
+    SelFormatBuffer& append(T value, int base = 10)
+    {
+        auto [ptr, ec] = std::to_chars(data.data() + length,
+                                       data.data() + N - 1, value, base);
+        return appended(ptr, ec);
+    }
+
+    // Formatted like std::to_string(double), with six decimal places.  A
+    // value too long for the room left is truncated like text, rather than
+    // left out.
+    SelFormatBuffer& append(double value)
+    {
+        auto [ptr, ec] =
+            std::to_chars(data.data() + length, data.data() + N - 1, value,
+                          std::chars_format::fixed, 6);
+        if (ec != std::errc())
+        {
+            return append(std::string_view(std::to_string(value)));
+        }
+        return appended(ptr, ec);
+    }
+
+    // A value that could not be read is written as "unknown"
+    SelFormatBuffer& append(const std::optional<double>& value)
+    {
+        return value ? append(*value) : append("unknown");
+    }
+
+    SelFormatBuffer& appendHex(std::span<const uint8_t> bytes)
+    {
+        bytes = bytes.first(std::min(bytes.size(), room() / 2));
+        length = selHexEncode(bytes, data.data() + length) - data.data();
+        data[length] = '\0';
+        return *this;
+    }
+
+    void clear()
+    {
+        length = 0;
+        data[0] = '\0';
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(data.data(), length);
+    }
+
+    const char* c_str() const
+    {
+        return data.data();
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+  private:
+    size_t room() const
+    {
+        return N - 1 - length;
+    }
+
+    SelFormatBuffer& appended(char* end, std::errc ec)
+    {
+        if (ec == std::errc())
+        {
+            length = end - data.data();
+        }
+        data[length] = '\0';
+        return *this;
+    }
+
+    std::array<char, N> data;
+    size_t length = 0;
+};
+
+// Enough for any journal message the daemon builds itself
+using SelMessageBuffer = SelFormatBuffer<512>;
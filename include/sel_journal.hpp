@@ -0,0 +1,100 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <sys/uio.h>
+#include <systemd/sd-journal.h>
+
+#include <sel_format.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Name of a journal field together with the '=' that ends it, so the prefix
+// of every field is a compile-time constant
+template <size_t N>
+struct SelJournalFieldName
+{
+    constexpr SelJournalFieldName(const char (&name)[N])
+    {
+        std::copy_n(name, N - 1, prefix.begin());
+        prefix[N - 1] = '=';
+    }
+
+    constexpr std::string_view view() const
+    {
+        return std::string_view(prefix.data(), prefix.size());
+    }
+
+    std::array<char, N> prefix{};
+};
+
+/** @class SelJournalField
+ *  @brief A "NAME=value" journal field with room for ValueSize characters of
+ *  value, built in place on the stack
+ */
+template <SelJournalFieldName Name, size_t ValueSize>
+class SelJournalField :
+    public SelFormatBuffer<Name.prefix.size() + ValueSize + 1>
+{
+  public:
+    SelJournalField()
+    {
+        this->append(Name.view());
+    }
+};
+
+// A journal field whose value can be any length.  The field is built in a
+// buffer that keeps its capacity between records, so it only allocates when
+// a value is longer than any before it.
+template <SelJournalFieldName Name>
+std::string_view selJournalTextField(std::string_view value)
+{
+    thread_local std::string field;
+    field.assign(Name.view());
+    field.append(value);
+    return field;
+}
+
+inline std::string_view selJournalFieldView(std::string_view field)
+{
+    return field;
+}
+
+template <size_t N>
+std::string_view selJournalFieldView(const SelFormatBuffer<N>& field)
+{
+    return field.view();
+}
+
+template <typename Field>
+iovec selJournalIovec(const Field& field)
+{
+    std::string_view view = selJournalFieldView(field);
+    return iovec{const_cast<char*>(view.data()), view.size()};
+}
+
+// Send complete "NAME=value" fields to the journal as one entry, without any
+// format string parsing
+template <typename... Fields>
+int selJournalSend(const Fields&... fields)
+{
+    std::array<iovec, sizeof...(Fields)> iov{selJournalIovec(fields)...};
+    return sd_journal_sendv(iov.data(), iov.size());
+}
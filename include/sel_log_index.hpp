@@ -0,0 +1,495 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/container/flat_map.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Parse the record ID from an ipmi_sel line: "<timestamp> <id>,<type>,..."
+inline std::optional<uint16_t> parseSelLineRecordId(std::string_view line)
+{
+    size_t left = line.find(' ');
+    if (left == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+    line.remove_prefix(left + 1);
+    uint16_t recordId = 0;
+    auto [ptr, ec] =
+        std::from_chars(line.data(), line.data() + line.size(), recordId);
+    if (ec != std::errc() || ptr == line.data() + line.size() || *ptr != ',')
+    {
+        return std::nullopt;
+    }
+    return recordId;
+}
+
+// Get the highest record ID among the last count records of an ipmi_sel
+// file by reading it backwards from the end, so only the tail of a large file
+// is read.  count is reduced by the number of records found, so the rest can
+// be looked for in the next older file.
+inline std::optional<uint16_t>
+    readHighestSelRecordId(const std::filesystem::path& path, size_t& count)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return std::nullopt;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return std::nullopt;
+    }
+
+    // Lines are short, so a few KiB from the end almost always hold the last
+    // complete ones; read further back only if they don't
+    constexpr size_t chunkSize = 4096;
+    std::string tail;
+    off_t offset = st.st_size;
+    std::optional<uint16_t> recordId;
+    auto found = [&](std::optional<uint16_t> lineRecordId) {
+        if (lineRecordId)
+        {
+            recordId = std::max(recordId.value_or(0), *lineRecordId);
+            count--;
+        }
+    };
+    while (offset > 0 && count != 0)
+    {
+        size_t toRead = std::min<off_t>(chunkSize, offset);
+        offset -= toRead;
+        std::string chunk(toRead, '\0');
+        if (pread(fd, chunk.data(), toRead, offset) !=
+            static_cast<ssize_t>(toRead))
+        {
+            break;
+        }
+        // Only the lines not parsed yet are kept
+        tail.insert(0, chunk);
+
+        // Try the lines from the last one back, skipping any that are
+        // partially written or not a SEL record
+        std::string_view lines(tail);
+        while (!lines.empty() && count != 0)
+        {
+            if (lines.back() == '\n')
+            {
+                lines.remove_suffix(1);
+                continue;
+            }
+            size_t lineStart = lines.rfind('\n');
+            if (lineStart == std::string_view::npos)
+            {
+                // The start of this line has not been read yet
+                if (offset == 0)
+                {
+                    found(parseSelLineRecordId(lines));
+                    lines = {};
+                }
+                break;
+            }
+            found(parseSelLineRecordId(lines.substr(lineStart + 1)));
+            lines.remove_suffix(lines.size() - lineStart);
+        }
+        tail.resize(lines.size());
+    }
+    close(fd);
+    return recordId;
+}
+
+/** @class SelLogIndex
+ *  @brief Index from SEL record ID to its line in the ipmi_sel log files
+ *  @details rsyslog writes the log files, so the daemon can't know where a
+ *  record lands when it is added.  Instead the index remembers how far into
+ *  each file it has read (files are tracked by inode so rotation is just a
+ *  rename) and only reads the bytes appended since then when it needs to be
+ *  brought up to date.  Deleting records then only touches the files that
+ *  hold them, without parsing or copying any of the other files.
+ */
+class SelLogIndex
+{
+  public:
+    SelLogIndex(const std::filesystem::path& logDir,
+                const std::string& logFilename) :
+        logDir(logDir), logFilename(logFilename)
+    {}
+
+    struct Location
+    {
+        ino_t inode;
+        off_t offset;
+        // Length of the line including the newline
+        size_t length;
+    };
+
+    // Read anything added to the log files since the last refresh
+    void refresh()
+    {
+        std::vector<std::filesystem::path> logFiles;
+        std::error_code ec;
+        for (const std::filesystem::directory_entry& dirEnt :
+             std::filesystem::directory_iterator(logDir, ec))
+        {
+            if (dirEnt.path().filename().string().starts_with(logFilename))
+            {
+                logFiles.emplace_back(dirEnt.path());
+            }
+        }
+        // Sorted from newest to oldest, so index the oldest first and let
+        // newer copies of a record ID replace older ones
+        std::sort(logFiles.begin(), logFiles.end());
+
+        boost::container::flat_map<ino_t, IndexedFile> current;
+        for (auto file = logFiles.rbegin(); file != logFiles.rend(); file++)
+        {
+            struct stat st{};
+            if (stat(file->c_str(), &st) < 0)
+            {
+                continue;
+            }
+            IndexedFile indexed{*file, 0};
+            auto findFile = files.find(st.st_ino);
+            if (findFile != files.end() &&
+                findFile->second.indexedSize <= st.st_size)
+            {
+                indexed.indexedSize = findFile->second.indexedSize;
+            }
+            else if (findFile != files.end())
+            {
+                // The file shrank underneath us, so index it from scratch
+                dropFile(st.st_ino);
+            }
+            if (indexed.indexedSize < st.st_size)
+            {
+                indexed.indexedSize =
+                    indexFile(*file, st.st_ino, indexed.indexedSize);
+            }
+            current.emplace(st.st_ino, indexed);
+        }
+
+        // Forget about files that have been rotated out
+        for (const auto& [inode, file] : files)
+        {
+            if (!current.contains(inode))
+            {
+                dropFile(inode);
+            }
+        }
+        files = std::move(current);
+    }
+
+    std::optional<Location> find(uint16_t recordId)
+    {
+        auto findEntry = entries.find(recordId);
+        if (findEntry == entries.end())
+        {
+            // The record may have been written since the last refresh
+            refresh();
+            findEntry = entries.find(recordId);
+            if (findEntry == entries.end())
+            {
+                return std::nullopt;
+            }
+        }
+        return findEntry->second;
+    }
+
+    // Path of the log file a location refers to
+    std::optional<std::filesystem::path> getFile(const Location& location)
+    {
+        auto findFile = files.find(location.inode);
+        if (findFile == files.end())
+        {
+            return std::nullopt;
+        }
+        return findFile->second.path;
+    }
+
+    // Remove the line holding recordId from its log file, returns false if
+    // the record is not in any of the log files
+    bool remove(uint16_t recordId)
+    {
+        return !remove(std::span<const uint16_t>(&recordId, 1)).empty();
+    }
+
+    // Remove the lines holding several records, rewriting each affected file
+    // only once.  Returns the record IDs that were found and removed.
+    std::vector<uint16_t> remove(std::span<const uint16_t> recordIds)
+    {
+        boost::container::flat_map<ino_t, std::vector<Removal>> removals;
+        if (!locate(recordIds, removals))
+        {
+            // The files changed in a way the index didn't see, start over
+            files.clear();
+            entries.clear();
+            refresh();
+            removals.clear();
+            locate(recordIds, removals);
+        }
+
+        std::vector<uint16_t> removed;
+        for (auto& [inode, fileRemovals] : removals)
+        {
+            std::sort(fileRemovals.begin(), fileRemovals.end(),
+                      [](const Removal& a, const Removal& b) {
+                          return a.location.offset < b.location.offset;
+                      });
+            if (!removeLines(files[inode].path, fileRemovals))
+            {
+                continue;
+            }
+
+            // Everything after a removed line in the same file moved back
+            size_t removedLength = 0;
+            for (const Removal& removal : fileRemovals)
+            {
+                entries.erase(removal.recordId);
+                removed.push_back(removal.recordId);
+                removedLength += removal.location.length;
+            }
+            for (auto& [id, entry] : entries)
+            {
+                if (entry.inode != inode)
+                {
+                    continue;
+                }
+                auto next = std::upper_bound(
+                    fileRemovals.begin(), fileRemovals.end(), entry.offset,
+                    [](off_t offset, const Removal& removal) {
+                        return offset < removal.location.offset;
+                    });
+                for (auto removal = fileRemovals.begin(); removal != next;
+                     removal++)
+                {
+                    entry.offset -= removal->location.length;
+                }
+            }
+            files[inode].indexedSize -= removedLength;
+        }
+        return removed;
+    }
+
+    void clear()
+    {
+        files.clear();
+        entries.clear();
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+  private:
+    struct IndexedFile
+    {
+        std::filesystem::path path;
+        // Bytes of the file that have been indexed, always a line boundary
+        off_t indexedSize;
+    };
+
+    static constexpr size_t readChunkSize = 4096;
+
+    // Index the complete lines of a file from offset, returning the offset
+    // just past the last complete line
+    off_t indexFile(const std::filesystem::path& path, ino_t inode,
+                    off_t offset)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return offset;
+        }
+        std::array<char, readChunkSize> buffer;
+        std::string partial;
+        off_t lineStart = offset;
+        ssize_t bytesRead = 0;
+        while ((bytesRead = pread(fd, buffer.data(), buffer.size(), offset)) >
+               0)
+        {
+            std::string_view chunk(buffer.data(), bytesRead);
+            while (!chunk.empty())
+            {
+                size_t newline = chunk.find('\n');
+                if (newline == std::string_view::npos)
+                {
+                    partial.append(chunk);
+                    break;
+                }
+                std::string_view line = chunk.substr(0, newline);
+                if (!partial.empty())
+                {
+                    partial.append(line);
+                    line = partial;
+                }
+                size_t length = line.size() + 1;
+                if (std::optional<uint16_t> recordId =
+                        parseSelLineRecordId(line))
+                {
+                    entries[*recordId] = Location{inode, lineStart, length};
+                }
+                lineStart += length;
+                partial.clear();
+                chunk.remove_prefix(newline + 1);
+            }
+            offset += bytesRead;
+        }
+        close(fd);
+        return lineStart;
+    }
+
+    // Check that a location still holds the expected record
+    bool verify(uint16_t recordId, const Location& location)
+    {
+        std::optional<std::filesystem::path> path = getFile(location);
+        if (!path)
+        {
+            return false;
+        }
+        int fd = open(path->c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        std::string line(location.length, '\0');
+        ssize_t bytesRead =
+            pread(fd, line.data(), location.length, location.offset);
+        close(fd);
+        if (bytesRead != static_cast<ssize_t>(location.length) ||
+            line.back() != '\n')
+        {
+            return false;
+        }
+        line.pop_back();
+        return parseSelLineRecordId(line) == recordId;
+    }
+
+    struct Removal
+    {
+        uint16_t recordId;
+        Location location;
+    };
+
+    // Look up and verify the locations of the given records, grouped by file.
+    // Returns false if the index turned out to be out of date.
+    bool locate(std::span<const uint16_t> recordIds,
+                boost::container::flat_map<ino_t, std::vector<Removal>>&
+                    removals)
+    {
+        bool upToDate = true;
+        for (uint16_t recordId : recordIds)
+        {
+            std::optional<Location> location = find(recordId);
+            if (!location)
+            {
+                continue;
+            }
+            if (!verify(recordId, *location))
+            {
+                upToDate = false;
+                continue;
+            }
+            removals[location->inode].emplace_back(recordId, *location);
+        }
+        return upToDate;
+    }
+
+    // Remove lines, sorted by offset, from a file by moving the remaining
+    // data back over them in a single pass
+    static bool removeLines(const std::filesystem::path& path,
+                            const std::vector<Removal>& removals)
+    {
+        if (removals.empty())
+        {
+            return true;
+        }
+        int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        std::array<char, readChunkSize> buffer;
+        off_t writeOffset = removals.front().location.offset;
+        bool success = true;
+        for (size_t i = 0; i < removals.size() && success; i++)
+        {
+            const Location& removed = removals[i].location;
+            off_t readOffset = removed.offset + removed.length;
+            // Keep everything up to the next removed line, or to the end
+            off_t keepEnd = std::numeric_limits<off_t>::max();
+            if (i + 1 < removals.size())
+            {
+                keepEnd = removals[i + 1].location.offset;
+            }
+            while (readOffset < keepEnd)
+            {
+                size_t toRead = std::min<off_t>(buffer.size(),
+                                                keepEnd - readOffset);
+                ssize_t bytesRead =
+                    pread(fd, buffer.data(), toRead, readOffset);
+                if (bytesRead == 0)
+                {
+                    break;
+                }
+                if (bytesRead < 0 ||
+                    pwrite(fd, buffer.data(), bytesRead, writeOffset) !=
+                        bytesRead)
+                {
+                    success = false;
+                    break;
+                }
+                readOffset += bytesRead;
+                writeOffset += bytesRead;
+            }
+        }
+        if (success && ftruncate(fd, writeOffset) < 0)
+        {
+            success = false;
+        }
+        close(fd);
+        return success;
+    }
+
+    void dropFile(ino_t inode)
+    {
+        std::erase_if(entries, [inode](const auto& entry) {
+            return entry.second.inode == inode;
+        });
+    }
+
+    std::filesystem::path logDir;
+    std::string logFilename;
+    boost::container::flat_map<ino_t, IndexedFile> files;
+    std::unordered_map<uint16_t, Location> entries;
+};
@@ -15,15 +15,32 @@
 */
 
 #pragma once
-#include <systemd/sd-journal.h>
-
 #include <sdbusplus/asio/connection.hpp>
+#include <sel_format.hpp>
+#include <sel_journal.hpp>
+#include <sel_metrics.hpp>
+#include <sel_trace.hpp>
+#include <sensorutils.hpp>
+#ifdef SEL_LOGGER_BINARY_STORE
+#include <sel_binary_store.hpp>
+#endif
+#ifdef SEL_LOGGER_WRITER_THREAD
+#include <sel_writer.hpp>
+#endif
 #ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
 #include <xyz/openbmc_project/Logging/Entry/server.hpp>
 #endif
 
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <iostream>
+#include <map>
+#include <span>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
 
 static constexpr const char* ipmiSelObject = "xyz.openbmc_project.Logging.IPMI";
 static constexpr const char* ipmiSelPath = "/xyz/openbmc_project/Logging/IPMI";
@@ -35,21 +52,183 @@ static constexpr const char* ipmiSelAddInterface =
 static constexpr const char* selMessageId = "b370836ccf2f4850ac5bee185b77893a";
 static constexpr int selPriority = 5; // notice
 static constexpr uint8_t selSystemType = 0x02;
+// Journal fields that are the same for every SEL record
+static constexpr std::string_view selMessageIdField =
+    "MESSAGE_ID=b370836ccf2f4850ac5bee185b77893a";
+static constexpr std::string_view selPriorityField = "PRIORITY=5";
+static constexpr std::string_view selSystemTypeField = "IPMI_SEL_RECORD_TYPE=2";
+static_assert(selMessageIdField.ends_with(selMessageId));
+static_assert(selPriority == 5);
 static constexpr uint16_t selBMCGenID = 0x0020;
 static constexpr uint16_t selInvalidRecID =
     std::numeric_limits<uint16_t>::max();
 static constexpr size_t selEvtDataMaxSize = 3;
 static constexpr size_t selOemDataMaxSize = 13;
 static constexpr uint8_t selEvtDataUnspecified = 0xFF;
+// Event data of a system record, which the monitors always fill completely
+using SelEventData = std::array<uint8_t, selEvtDataMaxSize>;
+static constexpr uint8_t selEventTypeThreshold = 0x01;
+static constexpr uint8_t selEventTypeSensorSpecific = 0x6F;
+static constexpr uint8_t selSensorTypeProcessor = 0x07;
+static constexpr uint8_t selSensorTypeWatchdog2 = 0x23;
+
+// The sensor and event type of a system record, which only the binary store
+// keeps.  The IpmiSelAdd methods don't carry the event type, so records added
+// over D-Bus are stored as sensor-specific.
+struct SelSensorInfo
+{
+    uint8_t sensorType = ipmi::sensorTypeUnspecified;
+    uint8_t eventType = selEventTypeSensorSpecific;
+};
+
+// A record added over D-Bus about the object at path
+inline SelSensorInfo selDBusSensorInfo(std::string_view path)
+{
+    return SelSensorInfo{ipmi::getSensorTypeFromPath(path),
+                         selEventTypeSensorSpecific};
+}
+
+// A record about a threshold of the sensor at path
+inline SelSensorInfo selThresholdSensorInfo(std::string_view path)
+{
+    return SelSensorInfo{ipmi::getSensorTypeFromPath(path),
+                         selEventTypeThreshold};
+}
 
 static const std::filesystem::path selLogDir = "/var/log";
 static const std::string selLogFilename = "ipmi_sel";
 #ifdef SEL_LOGGER_ENABLE_SEL_DELETE
+// Record ID allocation state of older versions, migrated to the bitmap
 static const std::string nextRecordFilename = "next_records";
+static const std::string recordIdBitmapFilename = "next_records.bitmap";
+#ifdef SEL_LOGGER_SEL_DELETE_TOMBSTONES
+#if !defined(SEL_LOGGER_WRITER_THREAD) &&                                      \
+    !defined(SEL_LOGGER_SEND_TO_LOGGING_SERVICE)
+#error "Compaction runs on the writer thread, enable SEL_LOGGER_WRITER_THREAD"
+#endif
+// Must not start with selLogFilename, or it would be taken for a log file
+static const std::string selTombstoneFilename = "sel_tombstones";
+static constexpr size_t selCompactionThreshold =
+    SEL_LOGGER_SEL_DELETE_COMPACT_THRESHOLD;
+// How long after the last delete the tombstones below the threshold are
+// compacted
+static constexpr std::chrono::seconds selCompactionDelay(
+    SEL_LOGGER_SEL_DELETE_COMPACT_DELAY_S);
+// Most tombstones removed per compaction run before yielding to other work
+static constexpr size_t selCompactionBatchSize = 256;
+#endif
 uint16_t getNewRecordId();
 #else
 unsigned int getNewRecordId();
 #endif
+#ifdef SEL_LOGGER_BINARY_STORE
+static const std::string selBinaryStoreFilename = "sel_records.bin";
+
+// Whether the IDs of records the binary store overwrites are given out again.
+// Only record IDs of sel-delete builds are reused, and with the journal the
+// record is still in ipmi_sel.
+#if defined(SEL_LOGGER_ENABLE_SEL_DELETE) &&                                   \
+    defined(SEL_LOGGER_BINARY_STORE_NO_JOURNAL)
+static constexpr bool selReuseOverwrittenIds = true;
+#else
+static constexpr bool selReuseOverwrittenIds = false;
+#endif
+
+// The binary store SEL records are written to directly by the daemon
+inline SelBinaryStore& getSelBinaryStore()
+{
+    static SelBinaryStore store(selLogDir / selBinaryStoreFilename,
+                                SEL_LOGGER_BINARY_STORE_CAPACITY,
+                                selReuseOverwrittenIds);
+    return store;
+}
+#endif
+#ifdef SEL_LOGGER_WRITER_THREAD
+// The thread records are written to storage on
+inline SelWriter& getSelWriter()
+{
+    static SelWriter writer(
+        SEL_LOGGER_WRITER_QUEUE_DEPTH,
+        SelOverflowPolicy::SEL_LOGGER_WRITER_OVERFLOW,
+        SelBatchConfig{
+            std::chrono::microseconds(SEL_LOGGER_WRITER_BATCH_WINDOW_US),
+            SEL_LOGGER_WRITER_BATCH_RECORDS});
+    return writer;
+}
+
+// A critical record can be written ahead of every normal record that was
+// queued when it was added, so records reach storage out of record ID order
+// by at most this many
+static constexpr size_t selWriteReorderWindow =
+    SEL_LOGGER_WRITER_QUEUE_DEPTH + SEL_LOGGER_WRITER_BATCH_RECORDS;
+
+// Asserts of critical and non-recoverable thresholds are written ahead of
+// everything else
+inline SelWritePriority selSystemRecordPriority(
+    std::span<const uint8_t> selData, bool assert)
+{
+    if (!assert || selData.empty())
+    {
+        return SelWritePriority::normal;
+    }
+    switch (selData[0] & 0x0F)
+    {
+        case 0x02: // lower critical going low
+        case 0x04: // lower non-recoverable going low
+        case 0x09: // upper critical going high
+        case 0x0B: // upper non-recoverable going high
+            return SelWritePriority::critical;
+        default:
+            return SelWritePriority::normal;
+    }
+}
+#else
+// Records are written in record ID order
+static constexpr size_t selWriteReorderWindow = 1;
+#endif
+// Allocate count record IDs in one step, persisting the allocator state once
+std::vector<uint16_t> getNewRecordIds(size_t count);
+
+// Entries accepted by the IpmiSelAddBatch and IpmiSelAddOemBatch methods
+using SelSystemEntry = std::tuple<std::string, std::string,
+                                  std::vector<uint8_t>, bool, uint16_t>;
+using SelOemEntry = std::tuple<std::string, std::vector<uint8_t>, uint8_t>;
+
+// The arguments of an IpmiSelAdd call, or of one entry of a batch, as they
+// are traced
+struct IpmiSelAddCall
+{
+    static constexpr SelTraceKind traceKind = SelTraceKind::ipmiSelAdd;
+
+    std::string message;
+    std::string path;
+    std::vector<uint8_t> selData;
+    bool assert = false;
+    uint16_t genId = 0;
+
+    template <typename Self>
+    static auto traceFields(Self& self)
+    {
+        return std::tie(self.message, self.path, self.selData, self.assert,
+                        self.genId);
+    }
+};
+
+// The arguments of an IpmiSelAddOem call, or of one entry of a batch
+struct IpmiSelAddOemCall
+{
+    static constexpr SelTraceKind traceKind = SelTraceKind::ipmiSelAddOem;
+
+    std::string message;
+    std::vector<uint8_t> selData;
+    uint8_t recordType = 0;
+
+    template <typename Self>
+    static auto traceFields(Self& self)
+    {
+        return std::tie(self.message, self.selData, self.recordType);
+    }
+};
 
 #ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
 using LoggingEntry = sdbusplus::xyz::openbmc_project::Logging::server::Entry;
@@ -61,26 +240,136 @@ enum class eventReading : uint8_t
     upperNonCritGoingHigh = 0x07,
     upperCritGoingHigh = 0x09
 };
+
+// Create an entry through the logging service without waiting for the reply,
+// so a slow logging service can't stall the main loop
+inline void createLogEntry(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const std::string& message, const std::string& severity,
+    const std::map<std::string, std::string>& additionalData)
+{
+    conn->async_method_call(
+        [event = selMetricsEvent](boost::system::error_code ec) {
+            if (ec)
+            {
+                std::cerr << "Failed adding this event: " << ec.message()
+                          << "\n";
+                selMetricsFailed(event);
+                return;
+            }
+            selMetricsWritten(event);
+        },
+        "xyz.openbmc_project.Logging", "/xyz/openbmc_project/logging",
+        "xyz.openbmc_project.Logging.Create", "Create", message, severity,
+        additionalData);
+}
 #endif
 
-void toHexStr(const std::vector<uint8_t>& data, std::string& hexStr);
+#ifndef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+// metadata are additional complete journal fields, e.g. a SelJournalField
+template <typename... T>
+void selJournalSystemRecord(unsigned int recordId, std::string_view message,
+                            const std::string& path,
+                            std::span<const uint8_t> selData,
+                            const bool& assert, const uint16_t& genId,
+                            const T&... metadata)
+{
+    SelJournalField<"IPMI_SEL_RECORD_ID", 5> recordIdField;
+    recordIdField.append(recordId);
+    SelJournalField<"IPMI_SEL_GENERATOR_ID", 4> genIdField;
+    genIdField.append(genId, 16);
+    SelJournalField<"IPMI_SEL_EVENT_DIR", 1> eventDirField;
+    eventDirField.append(assert);
+    SelJournalField<"IPMI_SEL_DATA", selEvtDataMaxSize * 2> selDataField;
+    selDataField.appendHex(selData);
+
+    selJournalSend(
+        selJournalTextField<"MESSAGE">(message), selPriorityField,
+        selMessageIdField, recordIdField, selSystemTypeField, genIdField,
+        selJournalTextField<"IPMI_SEL_SENSOR_PATH">(path), eventDirField,
+        selDataField, metadata...);
+}
+
+// Store a system record that has been given a record ID in the binary store
+// and/or the journal, depending on how the daemon was built
+template <typename... T>
+void selStoreSystemRecord(unsigned int recordId,
+                          [[maybe_unused]] std::string_view message,
+                          [[maybe_unused]] const std::string& path,
+                          std::span<const uint8_t> selData, const bool& assert,
+                          const uint16_t& genId,
+                          [[maybe_unused]] const SelSensorInfo& sensor,
+                          [[maybe_unused]] const T&... metadata)
+{
+#ifdef SEL_LOGGER_BINARY_STORE
+    getSelBinaryStore().addSystemRecord(recordId, genId, sensor.sensorType,
+                                        sensor.eventType, assert, selData);
+#endif
+#ifndef SEL_LOGGER_BINARY_STORE_NO_JOURNAL
+    selJournalSystemRecord(recordId, message, path, selData, assert, genId,
+                           metadata...);
+#endif
+}
+
+// Write a system record that has been given a record ID, either now or on
+// the writer thread
+template <typename... T>
+void selWriteSystemRecord(unsigned int recordId, std::string_view message,
+                          const std::string& path,
+                          std::span<const uint8_t> selData, const bool& assert,
+                          const uint16_t& genId, const SelSensorInfo& sensor,
+                          const T&... metadata)
+{
+#ifdef SEL_LOGGER_WRITER_THREAD
+    // The arguments may not outlive this call, so the job keeps copies
+    std::array<std::string, sizeof...(T)> fields{
+        std::string(selJournalFieldView(metadata))...};
+    getSelWriter().push(
+        selSystemRecordPriority(selData, assert), recordId,
+        [recordId, message = std::string(message), path,
+         data = std::vector<uint8_t>(selData.begin(), selData.end()), assert,
+         genId, sensor, fields = std::move(fields),
+         event = selMetricsEvent](bool write) {
+            if (!write)
+            {
+                selMetricsSuppressed(event);
+                return;
+            }
+            std::apply(
+                [&](const auto&... field) {
+                    selStoreSystemRecord(recordId, message, path, data, assert,
+                                         genId, sensor, field...);
+                },
+                fields);
+            selMetricsWritten(event);
+        },
+        selCommitDone());
+#else
+    selStoreSystemRecord(recordId, message, path, selData, assert, genId,
+                         sensor, metadata...);
+    selMetricsWritten();
+#endif
+}
+#endif
 
 template <typename... T>
 uint16_t selAddSystemRecord(
     [[maybe_unused]] std::shared_ptr<sdbusplus::asio::connection> conn,
-    [[maybe_unused]] const std::string& message, const std::string& path,
-    const std::vector<uint8_t>& selData, const bool& assert,
-    const uint16_t& genId, [[maybe_unused]] T&&... metadata)
+    [[maybe_unused]] std::string_view message, const std::string& path,
+    std::span<const uint8_t> selData, const bool& assert,
+    const uint16_t& genId, [[maybe_unused]] const SelSensorInfo& sensor,
+    [[maybe_unused]] const T&... metadata)
 {
     // Only 3 bytes of SEL event data are allowed in a system record
     if (selData.size() > selEvtDataMaxSize)
     {
         throw std::invalid_argument("Event data too large");
     }
+
+#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
     std::string selDataStr;
     toHexStr(selData, selDataStr);
 
-#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
     auto severity = LoggingEntry::Level::Informational;
     switch (static_cast<eventReading>(selData[0]))
     {
@@ -100,36 +389,28 @@ uint16_t selAddSystemRecord(
         severity = LoggingEntry::Level::Informational;
     }
 
-    sdbusplus::message_t AddToLog = conn->new_method_call(
-        "xyz.openbmc_project.Logging", "/xyz/openbmc_project/logging",
-        "xyz.openbmc_project.Logging.Create", "Create");
-
-    std::string journalMsg(
-        message + " from " + path + ": " +
-        " RecordType=" + std::to_string(selSystemType) +
-        ", GeneratorID=" + std::to_string(genId) +
-        ", EventDir=" + std::to_string(assert) + ", EventData=" + selDataStr);
-
-    AddToLog.append(journalMsg, LoggingEntry::convertLevelToString(severity),
-                    std::map<std::string, std::string>(
-                        {{"SENSOR_PATH", path},
-                         {"GENERATOR_ID", std::to_string(genId)},
-                         {"RECORD_TYPE", std::to_string(selSystemType)},
-                         {"EVENT_DIR", std::to_string(assert)},
-                         {"SENSOR_DATA", selDataStr}}));
-    conn->call(AddToLog);
+    // Not a SelMessageBuffer, the caller's message can be any length
+    std::string journalMsg(message);
+    journalMsg += " from " + path +
+                  ":  RecordType=" + std::to_string(selSystemType) +
+                  ", GeneratorID=" + std::to_string(genId) +
+                  ", EventDir=" + std::to_string(assert) +
+                  ", EventData=" + selDataStr;
+
+    createLogEntry(conn, journalMsg,
+                   LoggingEntry::convertLevelToString(severity),
+                   {{"SENSOR_PATH", path},
+                    {"GENERATOR_ID", std::to_string(genId)},
+                    {"RECORD_TYPE", std::to_string(selSystemType)},
+                    {"EVENT_DIR", std::to_string(assert)},
+                    {"SENSOR_DATA", selDataStr}});
     return 0;
 #else
     unsigned int recordId = getNewRecordId();
     if (recordId < selInvalidRecID)
     {
-        sd_journal_send(
-            "MESSAGE=%s", message.c_str(), "PRIORITY=%i", selPriority,
-            "MESSAGE_ID=%s", selMessageId, "IPMI_SEL_RECORD_ID=%d", recordId,
-            "IPMI_SEL_RECORD_TYPE=%x", selSystemType,
-            "IPMI_SEL_GENERATOR_ID=%x", genId, "IPMI_SEL_SENSOR_PATH=%s",
-            path.c_str(), "IPMI_SEL_EVENT_DIR=%x", assert, "IPMI_SEL_DATA=%s",
-            selDataStr.c_str(), std::forward<T>(metadata)..., NULL);
+        selWriteSystemRecord(recordId, message, path, selData, assert, genId,
+                             sensor, metadata...);
     }
     return recordId;
 #endif
@@ -0,0 +1,274 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <boost/container/flat_map.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static constexpr const char* selMetricsPath =
+    "/xyz/openbmc_project/Logging/IPMI/Metrics";
+static constexpr const char* selMetricsInterface =
+    "xyz.openbmc_project.Logging.IPMI.Metrics";
+
+// Where the events the daemon handles come from
+enum class SelMetricSource : uint8_t
+{
+    ipmiSelAdd,
+    ipmiSelAddOem,
+    threshold,
+    thresholdAlarm,
+    watchdog,
+    pulse,
+    hostError,
+    selDelete,
+    clear,
+};
+
+// Names the sources are published under, in SelMetricSource order
+static constexpr std::array<std::string_view, 9> selMetricSourceNames{
+    "IpmiSelAdd", "IpmiSelAddOem", "Threshold", "ThresholdAlarm", "Watchdog",
+    "Pulse",      "HostError",     "SELDelete", "Clear",
+};
+
+using SelMetricsClock = std::chrono::steady_clock;
+
+// An event being handled, and when its signal or method call arrived
+struct SelMetricsEvent
+{
+    SelMetricSource source;
+    SelMetricsClock::time_point received;
+};
+
+/** @class SelMetrics
+ *  @brief Counters and latency histograms of each event source
+ *  @details Latencies run from when an event arrived to when its record was
+ *  committed to storage, and are counted in log2 buckets of microseconds:
+ *  bucket 0 counts latencies under 1 us, bucket i those of at least 2^(i-1)
+ *  us and under 2^i us, and the last bucket everything slower.  Everything
+ *  can be updated from any thread.
+ */
+class SelMetrics
+{
+  public:
+    static constexpr size_t latencyBuckets = 24;
+
+    using Counters = boost::container::flat_map<
+        std::string, boost::container::flat_map<std::string, uint64_t>>;
+    using Histograms =
+        boost::container::flat_map<std::string, std::vector<uint64_t>>;
+
+    void received(SelMetricSource source, size_t count = 1)
+    {
+        get(source).received.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    // A record of the event was committed to storage
+    void written(const SelMetricsEvent& event)
+    {
+        get(event.source).written.fetch_add(1, std::memory_order_relaxed);
+        committed(event);
+    }
+
+    // The change the event asked for was committed, without writing a record
+    void committed(const SelMetricsEvent& event)
+    {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            SelMetricsClock::now() - event.received);
+        uint64_t micros = latency.count() > 0 ? latency.count() : 0;
+        size_t bucket = std::min<size_t>(std::bit_width(micros),
+                                         latencyBuckets - 1);
+        get(event.source)
+            .latency[bucket]
+            .fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A record of the event was held back or dropped instead of written
+    void suppressed(SelMetricSource source)
+    {
+        get(source).suppressed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A D-Bus call made to handle the event failed
+    void failed(SelMetricSource source)
+    {
+        get(source).failures.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The event ran out of time waiting on D-Bus and was logged without
+    // what it was waiting for
+    void fallback(SelMetricSource source)
+    {
+        get(source).fallbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Counters counters() const
+    {
+        Counters counters;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            const Source& source = sources[i];
+            counters.emplace(
+                selMetricSourceNames[i],
+                boost::container::flat_map<std::string, uint64_t>{
+                    {"EventsReceived", source.received.load()},
+                    {"RecordsWritten", source.written.load()},
+                    {"RecordsSuppressed", source.suppressed.load()},
+                    {"DBusFailures", source.failures.load()},
+                    {"DeadlineFallbacks", source.fallbacks.load()}});
+        }
+        return counters;
+    }
+
+    Histograms latencyHistograms() const
+    {
+        Histograms histograms;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            std::vector<uint64_t>& histogram =
+                histograms[std::string(selMetricSourceNames[i])];
+            for (const std::atomic<uint64_t>& bucket : sources[i].latency)
+            {
+                histogram.push_back(bucket.load());
+            }
+        }
+        return histograms;
+    }
+
+  private:
+    struct Source
+    {
+        std::atomic<uint64_t> received{0};
+        std::atomic<uint64_t> written{0};
+        std::atomic<uint64_t> suppressed{0};
+        std::atomic<uint64_t> failures{0};
+        std::atomic<uint64_t> fallbacks{0};
+        std::array<std::atomic<uint64_t>, latencyBuckets> latency{};
+    };
+
+    Source& get(SelMetricSource source)
+    {
+        return sources[static_cast<size_t>(source)];
+    }
+
+    std::array<Source, selMetricSourceNames.size()> sources;
+};
+
+inline SelMetrics& getSelMetrics()
+{
+    static SelMetrics metrics;
+    return metrics;
+}
+
+// The event being handled on this thread.  Never set when metrics are
+// disabled, so nothing is counted.
+inline thread_local std::optional<SelMetricsEvent> selMetricsEvent;
+
+/** @class SelMetricsScope
+ *  @brief Makes an event the one being handled on this thread until the
+ *  scope ends
+ *  @details A handler that finishes an event asynchronously keeps a copy of
+ *  selMetricsEvent and opens a new scope with it in its callback, so the
+ *  event keeps its original arrival time.
+ */
+class SelMetricsScope
+{
+  public:
+    // Start handling count newly arrived events
+    explicit SelMetricsScope([[maybe_unused]] SelMetricSource source,
+                             [[maybe_unused]] size_t count = 1) :
+        previous(selMetricsEvent)
+    {
+#ifdef SEL_LOGGER_METRICS
+        getSelMetrics().received(source, count);
+        selMetricsEvent = SelMetricsEvent{source, SelMetricsClock::now()};
+#endif
+    }
+
+    // Carry on handling an event after an asynchronous step
+    explicit SelMetricsScope(const std::optional<SelMetricsEvent>& event) :
+        previous(selMetricsEvent)
+    {
+        selMetricsEvent = event;
+    }
+
+    ~SelMetricsScope()
+    {
+        selMetricsEvent = previous;
+    }
+
+    SelMetricsScope(const SelMetricsScope&) = delete;
+    SelMetricsScope& operator=(const SelMetricsScope&) = delete;
+
+  private:
+    std::optional<SelMetricsEvent> previous;
+};
+
+// Count against an event, the current one by default, if there is one
+inline void selMetricsWritten(
+    const std::optional<SelMetricsEvent>& event = selMetricsEvent)
+{
+    if (event)
+    {
+        getSelMetrics().written(*event);
+    }
+}
+
+inline void selMetricsCommitted(
+    const std::optional<SelMetricsEvent>& event = selMetricsEvent)
+{
+    if (event)
+    {
+        getSelMetrics().committed(*event);
+    }
+}
+
+inline void selMetricsSuppressed(
+    const std::optional<SelMetricsEvent>& event = selMetricsEvent)
+{
+    if (event)
+    {
+        getSelMetrics().suppressed(event->source);
+    }
+}
+
+inline void selMetricsFailed(
+    const std::optional<SelMetricsEvent>& event = selMetricsEvent)
+{
+    if (event)
+    {
+        getSelMetrics().failed(event->source);
+    }
+}
+
+inline void selMetricsFallback(
+    const std::optional<SelMetricsEvent>& event = selMetricsEvent)
+{
+    if (event)
+    {
+        getSelMetrics().fallback(event->source);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <boost/container/flat_set.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+/** @class SelTombstones
+ *  @brief Record IDs that have been deleted but are still in the log files
+ *  @details The IDs are kept in a sidecar file next to the log files, one
+ *  decimal ID per line, so readers of the log files can skip them until the
+ *  lines are compacted away.  Marking a record only appends a line to the
+ *  sidecar; it is rewritten when tombstones are dropped.
+ */
+class SelTombstones
+{
+  public:
+    explicit SelTombstones(const std::filesystem::path& file) : file(file) {}
+
+    void load()
+    {
+        ids.clear();
+        std::ifstream stream(file);
+        std::string line;
+        while (std::getline(stream, line))
+        {
+            uint16_t recordId = 0;
+            auto [ptr, ec] = std::from_chars(
+                line.data(), line.data() + line.size(), recordId);
+            if (ec == std::errc())
+            {
+                ids.insert(recordId);
+            }
+        }
+    }
+
+    bool contains(uint16_t recordId) const
+    {
+        return ids.contains(recordId);
+    }
+
+    void add(uint16_t recordId)
+    {
+        if (ids.insert(recordId).second)
+        {
+            std::ofstream stream(file, std::ios::app);
+            stream << recordId << '\n';
+        }
+    }
+
+    void remove(std::span<const uint16_t> recordIds)
+    {
+        for (uint16_t recordId : recordIds)
+        {
+            ids.erase(recordId);
+        }
+        if (ids.empty())
+        {
+            std::error_code ec;
+            std::filesystem::remove(file, ec);
+            return;
+        }
+        std::ofstream stream(file, std::ios::trunc);
+        for (uint16_t recordId : ids)
+        {
+            stream << recordId << '\n';
+        }
+    }
+
+    void clear()
+    {
+        ids.clear();
+        std::error_code ec;
+        std::filesystem::remove(file, ec);
+    }
+
+    // Up to count of the tombstoned IDs, lowest first
+    std::vector<uint16_t> first(size_t count) const
+    {
+        std::vector<uint16_t> recordIds(
+            ids.begin(), ids.begin() + std::min(count, ids.size()));
+        return recordIds;
+    }
+
+    size_t size() const
+    {
+        return ids.size();
+    }
+
+  private:
+    std::filesystem::path file;
+    boost::container::flat_set<uint16_t> ids;
+};
@@ -0,0 +1,511 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// What a trace record holds.  The values are stored in trace files, so they
+// must not change.
+enum class SelTraceKind : uint8_t
+{
+    thresholdAsserted = 1,
+    thresholdAlarm = 2,
+    sensorMetadata = 3,
+    watchdogTimeout = 4,
+    hostState = 5,
+    hostError = 6,
+    ipmiSelAdd = 7,
+    ipmiSelAddOem = 8,
+};
+
+// A trace file starts with the magic and version, followed by records of:
+//   varint  nanoseconds since the previous record (or the start of capture)
+//   uint8   SelTraceKind
+//   varint  payload size
+//   payload the event's fields, in the order of its traceFields()
+// Integers are varints, except bools and uint8_t which are a byte, doubles
+// are their 8 bytes little endian, and strings and byte vectors are a varint
+// size followed by the bytes.  An optional is a bool followed by the value if
+// it is set.
+static constexpr std::string_view selTraceMagic = "SELTRACE";
+static constexpr uint8_t selTraceVersion = 1;
+
+template <typename T>
+struct IsSelTraceOptional : std::false_type
+{};
+
+template <typename T>
+struct IsSelTraceOptional<std::optional<T>> : std::true_type
+{};
+
+/** @class SelTraceEncoder
+ *  @brief Appends values to a buffer in the trace encoding
+ */
+class SelTraceEncoder
+{
+  public:
+    template <typename T>
+    void append(const T& value)
+    {
+        if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, uint8_t>)
+        {
+            bytes.push_back(static_cast<char>(value));
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            appendVarint(static_cast<uint64_t>(value));
+        }
+        else if constexpr (std::is_same_v<T, double>)
+        {
+            uint64_t bits = std::bit_cast<uint64_t>(value);
+            for (size_t i = 0; i < sizeof(bits); i++)
+            {
+                bytes.push_back(static_cast<char>(bits >> (8 * i)));
+            }
+        }
+        else if constexpr (IsSelTraceOptional<T>::value)
+        {
+            append(value.has_value());
+            if (value)
+            {
+                append(*value);
+            }
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+        {
+            std::string_view text(value);
+            appendVarint(text.size());
+            bytes.append(text);
+        }
+        else
+        {
+            std::span<const uint8_t> data(value);
+            appendVarint(data.size());
+            bytes.append(reinterpret_cast<const char*>(data.data()),
+                         data.size());
+        }
+    }
+
+    void appendRaw(std::string_view raw)
+    {
+        bytes.append(raw);
+    }
+
+    void clear()
+    {
+        bytes.clear();
+    }
+
+    std::string_view view() const
+    {
+        return bytes;
+    }
+
+  private:
+    void appendVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            bytes.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<char>(value));
+    }
+
+    std::string bytes;
+};
+
+/** @class SelTraceDecoder
+ *  @brief Reads values in the trace encoding out of a payload
+ *  @details Reading past the end of the payload, or a value that doesn't fit
+ *  its type, fails the decoder, and every read after that fails too.
+ */
+class SelTraceDecoder
+{
+  public:
+    explicit SelTraceDecoder(std::string_view bytes) : bytes(bytes) {}
+
+    // Returns false if any value could not be read
+    template <typename... T>
+    bool read(T&... values)
+    {
+        (readOne(values), ...);
+        return ok;
+    }
+
+    // What hasn't been read yet
+    std::string_view rest() const
+    {
+        return bytes;
+    }
+
+  private:
+    template <typename T>
+    void readOne(T& value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            uint8_t byte = 0;
+            readOne(byte);
+            value = byte != 0;
+        }
+        else if constexpr (std::is_same_v<T, uint8_t>)
+        {
+            std::string_view byte = take(1);
+            value = byte.empty() ? 0 : static_cast<uint8_t>(byte[0]);
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            uint64_t varint = readVarint();
+            value = static_cast<T>(varint);
+            ok = ok && static_cast<uint64_t>(value) == varint;
+        }
+        else if constexpr (std::is_same_v<T, double>)
+        {
+            std::string_view raw = take(sizeof(uint64_t));
+            uint64_t bits = 0;
+            for (size_t i = 0; i < raw.size(); i++)
+            {
+                bits |= uint64_t{static_cast<uint8_t>(raw[i])} << (8 * i);
+            }
+            value = std::bit_cast<double>(bits);
+        }
+        else if constexpr (IsSelTraceOptional<T>::value)
+        {
+            bool hasValue = false;
+            readOne(hasValue);
+            value.reset();
+            if (hasValue)
+            {
+                readOne(value.emplace());
+            }
+        }
+        else
+        {
+            std::string_view raw = take(readVarint());
+            value.assign(raw.begin(), raw.end());
+        }
+    }
+
+    uint64_t readVarint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            std::string_view byte = take(1);
+            if (byte.empty())
+            {
+                return 0;
+            }
+            value |= uint64_t{static_cast<uint8_t>(byte[0]) & 0x7Fu} << shift;
+            if ((static_cast<uint8_t>(byte[0]) & 0x80) == 0)
+            {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    std::string_view take(size_t size)
+    {
+        if (!ok || size > bytes.size())
+        {
+            ok = false;
+            return {};
+        }
+        std::string_view taken = bytes.substr(0, size);
+        bytes.remove_prefix(size);
+        return taken;
+    }
+
+    std::string_view bytes;
+    bool ok = true;
+};
+
+/** @class SelTraceCapture
+ *  @brief Appends the events the daemon receives to a trace file
+ *  @details Each record is written as it is captured, so a trace is complete
+ *  up to the last event even if the daemon is killed.  Only used from the
+ *  main loop.
+ */
+class SelTraceCapture
+{
+  public:
+    SelTraceCapture() = default;
+
+    ~SelTraceCapture()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    SelTraceCapture(const SelTraceCapture&) = delete;
+    SelTraceCapture& operator=(const SelTraceCapture&) = delete;
+
+    bool active() const
+    {
+        return fd >= 0;
+    }
+
+    bool open(const std::string& path)
+    {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+        if (fd < 0)
+        {
+            std::cerr << "Failed to open trace file " << path << ": "
+                      << strerror(errno) << "\n";
+            return false;
+        }
+        frame.appendRaw(selTraceMagic);
+        frame.append(selTraceVersion);
+        last = std::chrono::steady_clock::now();
+        return flush();
+    }
+
+    template <typename... T>
+    void record(SelTraceKind kind, const T&... fields)
+    {
+        if (fd < 0)
+        {
+            return;
+        }
+        payload.clear();
+        (payload.append(fields), ...);
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        frame.append(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - last)
+                .count()));
+        last = now;
+        frame.append(static_cast<uint8_t>(kind));
+        frame.append(payload.view().size());
+        frame.appendRaw(payload.view());
+        flush();
+    }
+
+  private:
+    bool flush()
+    {
+        std::string_view bytes = frame.view();
+        while (!bytes.empty())
+        {
+            ssize_t written = write(fd, bytes.data(), bytes.size());
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written < 0)
+            {
+                // Stop capturing rather than write a corrupt trace
+                std::cerr << "Failed to write trace: " << strerror(errno)
+                          << "\n";
+                close(fd);
+                fd = -1;
+                frame.clear();
+                return false;
+            }
+            bytes.remove_prefix(written);
+        }
+        frame.clear();
+        return true;
+    }
+
+    int fd = -1;
+    std::chrono::steady_clock::time_point last;
+    SelTraceEncoder payload;
+    SelTraceEncoder frame;
+};
+
+inline SelTraceCapture& getSelTraceCapture()
+{
+    static SelTraceCapture capture;
+    return capture;
+}
+
+// Capture an event, if a capture is running.  Event has a traceKind and a
+// static traceFields() that ties the fields to trace, in order.
+template <typename Event>
+inline void selTraceEvent([[maybe_unused]] const Event& event)
+{
+#ifdef SEL_LOGGER_TRACE
+    std::apply(
+        [](const auto&... fields) {
+            getSelTraceCapture().record(Event::traceKind, fields...);
+        },
+        Event::traceFields(event));
+#endif
+}
+
+// Decode an event captured by selTraceEvent()
+template <typename Event>
+inline std::optional<Event> selTraceDecode(std::string_view payload)
+{
+    Event event;
+    SelTraceDecoder decoder(payload);
+    bool ok = std::apply(
+        [&decoder](auto&... fields) { return decoder.read(fields...); },
+        Event::traceFields(event));
+    if (!ok)
+    {
+        return std::nullopt;
+    }
+    return event;
+}
+
+struct SelTraceRecord
+{
+    // Since the start of capture
+    std::chrono::nanoseconds time;
+    SelTraceKind kind;
+    std::string payload;
+};
+
+// Read every record of a trace file.  Returns false if it isn't a trace
+// file; a record cut short by the daemon being killed ends the trace.
+inline bool readSelTrace(const std::string& path,
+                         std::vector<SelTraceRecord>& records)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+    std::string_view trace(bytes);
+    if (!trace.starts_with(selTraceMagic) ||
+        trace.size() < selTraceMagic.size() + 1 ||
+        static_cast<uint8_t>(trace[selTraceMagic.size()]) != selTraceVersion)
+    {
+        return false;
+    }
+    trace.remove_prefix(selTraceMagic.size() + 1);
+
+    std::chrono::nanoseconds time{0};
+    while (!trace.empty())
+    {
+        uint64_t delta = 0;
+        uint8_t kind = 0;
+        std::string payload;
+        SelTraceDecoder decoder(trace);
+        if (!decoder.read(delta, kind, payload))
+        {
+            break;
+        }
+        trace = decoder.rest();
+
+        time += std::chrono::nanoseconds(delta);
+        records.push_back(SelTraceRecord{time, static_cast<SelTraceKind>(kind),
+                                         std::move(payload)});
+    }
+    return true;
+}
+
+/** @class SelTracePlayer
+ *  @brief Hands the records of a trace to a dispatcher from the main loop
+ *  @details Records are dispatched either at the times they were captured,
+ *  or one after another as fast as possible.  Either way the main loop runs
+ *  between records, so timers and completions of earlier records are handled
+ *  in between as they would be live.
+ */
+class SelTracePlayer
+{
+  public:
+    // Returns false if the record was skipped
+    using Dispatch = std::function<bool(const SelTraceRecord&)>;
+
+    SelTracePlayer(boost::asio::io_context& io,
+                   std::vector<SelTraceRecord>&& records, bool fast,
+                   Dispatch&& dispatch) :
+        io(io), timer(io), records(std::move(records)), fast(fast),
+        dispatch(std::move(dispatch))
+    {}
+
+    SelTracePlayer(const SelTracePlayer&) = delete;
+    SelTracePlayer& operator=(const SelTracePlayer&) = delete;
+
+    void start()
+    {
+        startTime = std::chrono::steady_clock::now();
+        next();
+    }
+
+    size_t replayed = 0;
+    size_t skipped = 0;
+
+  private:
+    void next()
+    {
+        if (index == records.size())
+        {
+            return;
+        }
+        const SelTraceRecord& record = records[index];
+        std::chrono::steady_clock::time_point due = startTime + record.time;
+        if (!fast && due > std::chrono::steady_clock::now())
+        {
+            timer.expires_at(due);
+            timer.async_wait([this](const boost::system::error_code& ec) {
+                if (!ec)
+                {
+                    next();
+                }
+            });
+            return;
+        }
+        index++;
+        if (dispatch(record))
+        {
+            replayed++;
+        }
+        else
+        {
+            skipped++;
+        }
+        boost::asio::post(io, [this]() { next(); });
+    }
+
+    boost::asio::io_context& io;
+    boost::asio::steady_timer timer;
+    std::vector<SelTraceRecord> records;
+    const bool fast;
+    Dispatch dispatch;
+    size_t index = 0;
+    std::chrono::steady_clock::time_point startTime;
+};
@@ -0,0 +1,494 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Records that are written ahead of everything else
+enum class SelWritePriority : uint8_t
+{
+    normal,
+    critical,
+};
+
+// What to do with a normal record when its lane is full.  Callers that can
+// wait without blocking the thread they run on wait for room before they
+// queue anything, so this only applies to the others.  Critical records are
+// never dropped.
+enum class SelOverflowPolicy : uint8_t
+{
+    // Drop the oldest queued normal record to make room
+    dropOldest,
+    // Drop the record being added
+    dropNewest,
+};
+
+// How the writer groups records into batches
+struct SelBatchConfig
+{
+    // How long the first record of a batch waits for others to join it
+    std::chrono::microseconds window{0};
+    // Most records in one batch
+    size_t maxRecords = 1;
+};
+
+/** @class SelWriter
+ *  @brief Writes SEL records to storage on a thread of its own
+ *  @details Records are queued by the D-Bus front end and written in order by
+ *  the writer thread, with critical records skipping ahead of any queued
+ *  normal ones, so records can reach storage out of record ID order.  Each
+ *  priority has its own lane, so a burst of normal records can't delay a
+ *  critical record, and the normal lane is bounded, so a burst can't run the
+ *  daemon out of memory either.  Queueing never blocks, and records may be
+ *  queued from any thread.
+ *
+ *  Records are written in batches: the writer waits up to the batch window
+ *  for more records to arrive before it writes, unless the batch fills up or
+ *  a critical record arrives.  Once a batch is written, the done callbacks
+ *  of its records are handed to the commit handler together.
+ *
+ *  A barrier runs a job on the writer thread once every record queued before
+ *  it, of either priority, has been written, and before any record queued
+ *  after it.  That is where the stores can be changed without racing the
+ *  writer.
+ */
+class SelWriter
+{
+  public:
+    // Called with true to write the record, or with false, on the thread that
+    // queued the record that caused it, if the record is dropped instead
+    using Job = std::function<void(bool)>;
+    // Called with true once a record has been written, or with false if it
+    // was dropped
+    using Done = std::function<void(bool)>;
+    // Called with the done callbacks of each written batch, which may be
+    // none, and true, on the writer thread once the batch is written, and of
+    // each dropped record and false, on the thread that queued the record
+    // that caused it.  Must be set before anything with a done callback is
+    // queued.
+    using CommitHandler = std::function<void(std::vector<Done>&&, bool)>;
+    // Called with the record ID of each record that is dropped, on the thread
+    // that queued the record that caused it
+    using DropHandler = std::function<void(uint16_t)>;
+    // Run by a barrier on the writer thread, must not throw
+    using BarrierJob = std::function<void()>;
+    // Called on the writer thread once there is room for the records a
+    // caller is waiting to queue
+    using RoomHandler = std::function<void()>;
+
+    SelWriter(size_t depth, SelOverflowPolicy policy,
+              const SelBatchConfig& batch) :
+        depth(depth), policy(policy), batch(batch), thread([this]() { run(); })
+    {}
+
+    ~SelWriter()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        notEmpty.notify_one();
+        thread.join();
+    }
+
+    SelWriter(const SelWriter&) = delete;
+    SelWriter& operator=(const SelWriter&) = delete;
+
+    void setDropHandler(DropHandler&& handler)
+    {
+        std::lock_guard lock(mutex);
+        dropHandler = std::move(handler);
+    }
+
+    void setCommitHandler(CommitHandler&& handler)
+    {
+        std::lock_guard lock(mutex);
+        commitHandler = std::move(handler);
+    }
+
+    // Queue a record to be written by job.  Returns false if the record was
+    // dropped instead.  Never waits: a full normal lane drops a record, as
+    // the overflow policy says, and a critical record is queued past the
+    // depth of its lane, since critical records are few and never dropped.
+    // Records ahead of a barrier are never dropped to make room, since the
+    // barrier's job may depend on them, so with dropOldest the new record is
+    // dropped instead if they are all there is.
+    bool push(SelWritePriority priority, uint16_t recordId, Job&& job,
+              Done&& done = {})
+    {
+        std::optional<uint16_t> droppedId;
+        Job droppedJob;
+        Done droppedDone;
+        bool queued = true;
+        bool wake = false;
+        DropHandler handler;
+        CommitHandler committed;
+        {
+            std::unique_lock lock(mutex);
+            std::deque<Entry>& queue = lane(priority);
+            if (queue.size() >= depth && priority == SelWritePriority::normal)
+            {
+                if (policy == SelOverflowPolicy::dropOldest &&
+                         (barriers.empty() ||
+                          queue.front().seq > barriers.back().seq))
+                {
+                    droppedId = queue.front().recordId;
+                    droppedJob = std::move(queue.front().job);
+                    droppedDone = std::move(queue.front().done);
+                    queue.pop_front();
+                }
+                else
+                {
+                    droppedId = recordId;
+                    droppedJob = std::move(job);
+                    droppedDone = std::move(done);
+                    queued = false;
+                }
+            }
+            if (droppedId)
+            {
+                if (droppedCount++ == 0)
+                {
+                    std::cerr << "SEL write queue full, dropping records\n";
+                }
+                handler = dropHandler;
+                committed = commitHandler;
+            }
+            else if (droppedCount != 0)
+            {
+                std::cerr << "SEL write queue dropped " << droppedCount
+                          << " records\n";
+                droppedCount = 0;
+            }
+            if (queued)
+            {
+                queue.emplace_back(nextSeq++, recordId, std::move(job),
+                                   std::move(done));
+                // Only wake the writer when it has something new to decide
+                size_t count = queuedCount();
+                wake = count == 1 || count >= batch.maxRecords ||
+                       priority == SelWritePriority::critical;
+            }
+        }
+        if (wake)
+        {
+            notEmpty.notify_one();
+        }
+        if (droppedJob)
+        {
+            droppedJob(false);
+        }
+        if (droppedId && handler)
+        {
+            handler(*droppedId);
+        }
+        if (droppedDone && committed)
+        {
+            std::vector<Done> dones;
+            dones.emplace_back(std::move(droppedDone));
+            committed(std::move(dones), false);
+        }
+        return queued;
+    }
+
+    // Whether count normal records can be queued now without dropping any.
+    // If not, ready is called once they can, so a caller can wait for that
+    // without blocking its thread.  Another caller may take the room first,
+    // so the caller asks again once ready has been called.
+    bool room(size_t count, RoomHandler&& ready)
+    {
+        std::lock_guard lock(mutex);
+        if (hasRoom(count))
+        {
+            return true;
+        }
+        roomWaiters.emplace_back(count, std::move(ready));
+        return false;
+    }
+
+    // Wait until a normal record can be queued without dropping any.  Blocks
+    // the calling thread, so the main loop uses room() instead.
+    void waitForRoom()
+    {
+        std::unique_lock lock(mutex);
+        notFull.wait(lock, [this]() { return hasRoom(1); });
+    }
+
+    // Run job on the writer thread once everything queued so far has been
+    // written, without waiting for it
+    void barrier(BarrierJob&& job)
+    {
+        {
+            std::lock_guard lock(mutex);
+            barriers.emplace_back(nextSeq++, std::move(job));
+        }
+        // Also cuts a batch window short, the barrier is waiting on it
+        notEmpty.notify_one();
+    }
+
+    // Wait until everything queued so far has been written.  Blocks the
+    // calling thread, so the main loop uses a barrier instead.
+    void drain()
+    {
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [this]() {
+            return !busy && queuedCount() == 0 && barriers.empty();
+        });
+    }
+
+  private:
+    struct Entry
+    {
+        Entry(uint64_t seq, uint16_t recordId, Job&& job, Done&& done) :
+            seq(seq), recordId(recordId), job(std::move(job)),
+            done(std::move(done))
+        {}
+
+        // Order of queueing across both lanes and the barriers
+        uint64_t seq;
+        uint16_t recordId;
+        Job job;
+        Done done;
+    };
+
+    struct RoomWaiter
+    {
+        RoomWaiter(size_t count, RoomHandler&& ready) :
+            count(count), ready(std::move(ready))
+        {}
+
+        size_t count;
+        RoomHandler ready;
+    };
+
+    struct Barrier
+    {
+        Barrier(uint64_t seq, BarrierJob&& job) : seq(seq), job(std::move(job))
+        {}
+
+        uint64_t seq;
+        BarrierJob job;
+    };
+
+    bool hasRoom(size_t count) const
+    {
+        const std::deque<Entry>& queue =
+            lanes[static_cast<size_t>(SelWritePriority::normal)];
+        return queue.size() + count <= depth;
+    }
+
+    size_t queuedCount() const
+    {
+        return lanes[0].size() + lanes[1].size();
+    }
+
+    // Whether the front record of a lane may be written, which it can't be
+    // until the barriers queued before it have run
+    bool writable(const std::deque<Entry>& queue) const
+    {
+        return !queue.empty() &&
+               (barriers.empty() || queue.front().seq < barriers.front().seq);
+    }
+
+    // Whether the first barrier has nothing left ahead of it
+    bool barrierDue() const
+    {
+        return !barriers.empty() && !writable(lanes[0]) && !writable(lanes[1]);
+    }
+
+    // Records that may be written now, up to max
+    size_t writableCount(size_t max) const
+    {
+        size_t count = 0;
+        for (const std::deque<Entry>& queue : lanes)
+        {
+            for (const Entry& entry : queue)
+            {
+                if (count == max ||
+                    (!barriers.empty() && entry.seq > barriers.front().seq))
+                {
+                    break;
+                }
+                count++;
+            }
+        }
+        return count;
+    }
+
+    std::deque<Entry>& lane(SelWritePriority priority)
+    {
+        return lanes[static_cast<size_t>(priority)];
+    }
+
+    void run()
+    {
+        std::unique_lock lock(mutex);
+        std::vector<Entry> entries;
+        std::vector<Done> dones;
+        while (true)
+        {
+            notEmpty.wait(lock, [this]() {
+                return stopping || queuedCount() != 0 || !barriers.empty();
+            });
+            if (barrierDue())
+            {
+                BarrierJob job = std::move(barriers.front().job);
+                barriers.pop_front();
+                busy = true;
+                lock.unlock();
+                job();
+                lock.lock();
+                busy = false;
+                if (queuedCount() == 0 && barriers.empty())
+                {
+                    idle.notify_all();
+                }
+                continue;
+            }
+            if (queuedCount() == 0)
+            {
+                // Only stopping once everything is written
+                return;
+            }
+            // Give more records a chance to join the batch, unless a barrier
+            // is waiting on them
+            notEmpty.wait_for(lock, batch.window, [this]() {
+                return stopping || !barriers.empty() ||
+                       writableCount(batch.maxRecords) >= batch.maxRecords ||
+                       writable(lane(SelWritePriority::critical));
+            });
+
+            // Critical first
+            for (SelWritePriority priority :
+                 {SelWritePriority::critical, SelWritePriority::normal})
+            {
+                std::deque<Entry>& queue = lane(priority);
+                while (writable(queue) && entries.size() < batch.maxRecords)
+                {
+                    entries.emplace_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+            busy = true;
+            CommitHandler committed = commitHandler;
+            std::vector<RoomHandler> ready;
+            std::erase_if(roomWaiters, [&](RoomWaiter& waiter) {
+                if (!hasRoom(waiter.count))
+                {
+                    return false;
+                }
+                ready.emplace_back(std::move(waiter.ready));
+                return true;
+            });
+            lock.unlock();
+            notFull.notify_all();
+            for (const RoomHandler& handler : ready)
+            {
+                handler();
+            }
+
+            for (Entry& entry : entries)
+            {
+                entry.job(true);
+                if (entry.done)
+                {
+                    dones.emplace_back(std::move(entry.done));
+                }
+            }
+            entries.clear();
+            if (committed)
+            {
+                committed(std::move(dones), true);
+            }
+            dones.clear();
+
+            lock.lock();
+            busy = false;
+            if (queuedCount() == 0 && barriers.empty())
+            {
+                idle.notify_all();
+            }
+        }
+    }
+
+    const size_t depth;
+    const SelOverflowPolicy policy;
+    const SelBatchConfig batch;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::condition_variable idle;
+    std::array<std::deque<Entry>, 2> lanes;
+    std::deque<Barrier> barriers;
+    std::vector<RoomWaiter> roomWaiters;
+    uint64_t nextSeq = 0;
+    DropHandler dropHandler;
+    CommitHandler commitHandler;
+    size_t droppedCount = 0;
+    bool busy = false;
+    bool stopping = false;
+    // Last, so everything it uses exists before it starts
+    std::thread thread;
+};
+
+// Counts the records a D-Bus caller is waiting on
+struct SelCommitGroup
+{
+    size_t pending = 0;
+    // Records that were dropped instead of written
+    size_t dropped = 0;
+    // Called once nothing is pending any more
+    std::function<void()> committed;
+};
+
+// The group records queued on this thread are counted in, if any
+inline thread_local std::shared_ptr<SelCommitGroup> selCommitGroup;
+
+// Count a record in the current commit group and get the callback that
+// uncounts it once it has been committed.  The callbacks must all be called
+// on the thread that owns the group.
+inline SelWriter::Done selCommitDone()
+{
+    std::shared_ptr<SelCommitGroup> group = selCommitGroup;
+    if (!group)
+    {
+        return {};
+    }
+    group->pending++;
+    return [group](bool written) {
+        if (!written)
+        {
+            group->dropped++;
+        }
+        if (--group->pending == 0 && group->committed)
+        {
+            group->committed();
+        }
+    };
+}
@@ -0,0 +1,444 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <boost/container/flat_map.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/bus/match.hpp>
+#include <sel_deadline.hpp>
+#include <sel_trace.hpp>
+#include <sensorutils.hpp>
+
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <variant>
+
+static constexpr const char* sensorValueInterface =
+    "xyz.openbmc_project.Sensor.Value";
+static constexpr const char* sensorPathNamespace =
+    "/xyz/openbmc_project/sensors";
+
+// The xyz.openbmc_project.Sensor.Value properties needed to scale a reading
+struct SensorValueProperties
+{
+    double max = 0;
+    double min = 0;
+    std::optional<double> scale;
+};
+
+/** @class SensorMetadataCache
+ *  @brief Per-sensor cache of the properties the threshold monitors read
+ *  @details MaxValue, MinValue, Scale and the threshold values almost never
+ *  change, so they are fetched once per sensor and then kept up to date from
+ *  threshold PropertiesChanged signals.  Sensor.Value PropertiesChanged is
+ *  deliberately not watched since it fires on every reading update; instead a
+ *  sensor is dropped from the cache when its interfaces are added or removed
+ *  (which is how sensors get reconfigured) or when its owning service changes.
+ *  Anything not cached is read asynchronously so a slow sensor service does
+ *  not stall the main loop, and a request that runs past the event deadline
+ *  is answered with whatever is cached instead of waiting any longer.
+ */
+class SensorMetadataCache
+{
+  public:
+    SensorMetadataCache(std::shared_ptr<sdbusplus::asio::connection> conn,
+                        const SelDeadlineConfig& deadlineConfig) :
+        conn(conn), deadlineConfig(deadlineConfig),
+        thresholdChangedMatch(
+            static_cast<sdbusplus::bus_t&>(*conn),
+            "type='signal',interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',path_namespace='" +
+                std::string(sensorPathNamespace) +
+                "',arg0namespace='xyz.openbmc_project.Sensor.Threshold'",
+            [this](sdbusplus::message_t& msg) { thresholdChanged(msg); }),
+        interfacesAddedMatch(
+            static_cast<sdbusplus::bus_t&>(*conn),
+            "type='signal',interface='org.freedesktop.DBus.ObjectManager',"
+            "member='InterfacesAdded',arg0path='" +
+                std::string(sensorPathNamespace) + "/'",
+            [this](sdbusplus::message_t& msg) { interfacesChanged(msg); }),
+        interfacesRemovedMatch(
+            static_cast<sdbusplus::bus_t&>(*conn),
+            "type='signal',interface='org.freedesktop.DBus.ObjectManager',"
+            "member='InterfacesRemoved',arg0path='" +
+                std::string(sensorPathNamespace) + "/'",
+            [this](sdbusplus::message_t& msg) { interfacesChanged(msg); })
+    {}
+
+    SensorMetadataCache(const SensorMetadataCache&) = delete;
+    SensorMetadataCache& operator=(const SensorMetadataCache&) = delete;
+
+    // Called with the sensor's Sensor.Value properties and the requested
+    // threshold value, either of which is empty if it could not be read
+    using MetadataHandler =
+        std::function<void(std::optional<SensorValueProperties>,
+                           std::optional<double>)>;
+
+    // Get the Sensor.Value properties and a threshold value of a sensor.  If
+    // they are cached the handler is called immediately, otherwise they are
+    // read asynchronously from the owning service.  Handlers for the same
+    // sensor are called in the order they were requested, except that one
+    // still waiting at the event deadline is called right away with what is
+    // cached.
+    void getMetadata(const std::string& owner, const std::string& path,
+                     const std::string& thresholdInterface,
+                     const std::string& threshold, MetadataHandler&& handler)
+    {
+        auto sharedHandler =
+            std::make_shared<MetadataHandler>(std::move(handler));
+        std::shared_ptr<SelEventDeadline> deadline = SelEventDeadline::start(
+            conn->get_io_context(), deadlineConfig.eventExpiry(),
+            [this, owner, path, threshold, sharedHandler]() {
+                std::cerr << "timed out getting sensor metadata from " << path
+                          << "\n";
+                std::optional<SensorValueProperties> value;
+                std::optional<double> thresholdValue;
+                auto findSensor = sensors.find(path);
+                if (findSensor != sensors.end() &&
+                    findSensor->second.owner == owner)
+                {
+                    value = findSensor->second.value;
+                    thresholdValue =
+                        cachedThreshold(findSensor->second, threshold);
+                }
+                (*sharedHandler)(value, thresholdValue);
+            });
+
+        std::deque<MetadataRequest>& queue = requests[path];
+        queue.emplace_back(owner, thresholdInterface, threshold,
+                           std::move(sharedHandler), std::move(deadline));
+        // Only start on this request if nothing else is outstanding for the
+        // sensor, otherwise it is picked up when the earlier ones complete
+        if (queue.size() == 1)
+        {
+            processRequests(path);
+        }
+    }
+
+  private:
+    struct SensorMetadata
+    {
+        std::string owner;
+        std::optional<SensorValueProperties> value;
+        boost::container::flat_map<std::string, double> thresholds;
+    };
+
+    struct MetadataRequest
+    {
+        std::string owner;
+        std::string thresholdInterface;
+        std::string threshold;
+        std::shared_ptr<MetadataHandler> handler;
+        // Calls handler with what is cached if the request waits too long
+        std::shared_ptr<SelEventDeadline> deadline;
+        bool valueFailed = false;
+        bool thresholdFailed = false;
+    };
+
+    SensorMetadata& getSensor(const std::string& owner,
+                              const std::string& path)
+    {
+        SensorMetadata& sensor = sensors[path];
+        // If the sensor is now owned by a different connection, the service
+        // was restarted and anything cached for it may be stale
+        if (sensor.owner != owner)
+        {
+            sensor = SensorMetadata{owner, std::nullopt, {}};
+        }
+        return sensor;
+    }
+
+    static std::optional<double> cachedThreshold(const SensorMetadata& sensor,
+                                                 const std::string& threshold)
+    {
+        auto findThreshold = sensor.thresholds.find(threshold);
+        if (findThreshold == sensor.thresholds.end())
+        {
+            return std::nullopt;
+        }
+        return findThreshold->second;
+    }
+
+    // Answer the queued requests for a sensor in order until one of them
+    // needs something that is not cached yet
+    void processRequests(const std::string& path)
+    {
+        auto findQueue = requests.find(path);
+        while (findQueue != requests.end() && !findQueue->second.empty())
+        {
+            MetadataRequest& request = findQueue->second.front();
+            // A request that ran out of time was already answered, so don't
+            // read anything more for it
+            if (request.deadline->expired())
+            {
+                findQueue->second.pop_front();
+                if (findQueue->second.empty())
+                {
+                    requests.erase(findQueue);
+                }
+                findQueue = requests.find(path);
+                continue;
+            }
+            SensorMetadata& sensor = getSensor(request.owner, path);
+            if (!sensor.value && !request.valueFailed)
+            {
+                fetchValueProperties(request.owner, path);
+                return;
+            }
+
+            std::optional<double> thresholdValue;
+            if (sensor.value)
+            {
+                thresholdValue = cachedThreshold(sensor, request.threshold);
+                if (!thresholdValue && !request.thresholdFailed)
+                {
+                    fetchThreshold(request.owner, path,
+                                   request.thresholdInterface,
+                                   request.threshold);
+                    return;
+                }
+            }
+
+            std::optional<SensorValueProperties> value = sensor.value;
+            std::shared_ptr<MetadataHandler> handler =
+                std::move(request.handler);
+            request.deadline->claim();
+            findQueue->second.pop_front();
+            if (findQueue->second.empty())
+            {
+                requests.erase(findQueue);
+            }
+            (*handler)(value, thresholdValue);
+            findQueue = requests.find(path);
+        }
+    }
+
+    void fetchValueProperties(const std::string& owner,
+                              const std::string& path)
+    {
+        conn->async_method_call_timed(
+            [this, owner, path](
+                boost::system::error_code ec,
+                const boost::container::flat_map<
+                    std::string, std::variant<double, int64_t>>& sensorValue) {
+                if (ec)
+                {
+                    fetchFailed(path, &MetadataRequest::valueFailed);
+                    return;
+                }
+
+                SensorValueProperties value;
+                auto findMax = sensorValue.find("MaxValue");
+                if (findMax != sensorValue.end())
+                {
+                    value.max = std::visit(ipmi::VariantToDoubleVisitor(),
+                                           findMax->second);
+                }
+                auto findMin = sensorValue.find("MinValue");
+                if (findMin != sensorValue.end())
+                {
+                    value.min = std::visit(ipmi::VariantToDoubleVisitor(),
+                                           findMin->second);
+                }
+                auto findScale = sensorValue.find("Scale");
+                if (findScale != sensorValue.end())
+                {
+                    value.scale = std::visit(ipmi::VariantToDoubleVisitor(),
+                                             findScale->second);
+                }
+                getSensor(owner, path).value = value;
+                processRequests(path);
+            },
+            owner, path, "org.freedesktop.DBus.Properties", "GetAll",
+            deadlineConfig.callTimeoutUs(), sensorValueInterface);
+    }
+
+    void fetchThreshold(const std::string& owner, const std::string& path,
+                        const std::string& thresholdInterface,
+                        const std::string& threshold)
+    {
+        conn->async_method_call_timed(
+            [this, owner, path,
+             threshold](boost::system::error_code ec,
+                        const std::variant<double, int64_t>& thresholdValue) {
+                if (ec)
+                {
+                    fetchFailed(path, &MetadataRequest::thresholdFailed);
+                    return;
+                }
+                getSensor(owner, path).thresholds[threshold] =
+                    std::visit(ipmi::VariantToDoubleVisitor(), thresholdValue);
+                processRequests(path);
+            },
+            owner, path, "org.freedesktop.DBus.Properties", "Get",
+            deadlineConfig.callTimeoutUs(), thresholdInterface, threshold);
+    }
+
+    // Let the request that started a failed read complete without it
+    void fetchFailed(const std::string& path, bool MetadataRequest::*failed)
+    {
+        auto findQueue = requests.find(path);
+        if (findQueue != requests.end() && !findQueue->second.empty())
+        {
+            findQueue->second.front().*failed = true;
+        }
+        processRequests(path);
+    }
+
+    void thresholdChanged(sdbusplus::message_t& msg)
+    {
+        auto findSensor = sensors.find(msg.get_path());
+        if (findSensor == sensors.end())
+        {
+            return;
+        }
+        SensorMetadata& sensor = findSensor->second;
+
+        std::string thresholdInterface;
+        boost::container::flat_map<std::string,
+                                   std::variant<double, int64_t, bool>>
+            propertiesChanged;
+        try
+        {
+            msg.read(thresholdInterface, propertiesChanged);
+        }
+        catch (const sdbusplus::exception_t&)
+        {
+            // Can't tell what changed, so read everything again next time
+            sensors.erase(findSensor);
+            return;
+        }
+
+        for (const auto& [property, value] : propertiesChanged)
+        {
+            // Only update thresholds that are already cached; the alarm
+            // properties are booleans and are never cached
+            auto findThreshold = sensor.thresholds.find(property);
+            if (findThreshold == sensor.thresholds.end())
+            {
+                continue;
+            }
+            if (const double* doubleValue = std::get_if<double>(&value))
+            {
+                findThreshold->second = *doubleValue;
+            }
+            else if (const int64_t* intValue = std::get_if<int64_t>(&value))
+            {
+                findThreshold->second = static_cast<double>(*intValue);
+            }
+            else
+            {
+                sensor.thresholds.erase(findThreshold);
+            }
+        }
+    }
+
+    void interfacesChanged(sdbusplus::message_t& msg)
+    {
+        sdbusplus::message::object_path path;
+        try
+        {
+            msg.read(path);
+        }
+        catch (const sdbusplus::exception_t&)
+        {
+            return;
+        }
+        sensors.erase(path.str);
+    }
+
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    SelDeadlineConfig deadlineConfig;
+    boost::container::flat_map<std::string, SensorMetadata> sensors;
+    // Outstanding requests per sensor path, answered in order
+    boost::container::flat_map<std::string, std::deque<MetadataRequest>>
+        requests;
+    sdbusplus::match thresholdChangedMatch;
+    sdbusplus::match interfacesAddedMatch;
+    sdbusplus::match interfacesRemovedMatch;
+};
+
+// Gets the metadata of a sensor the way SensorMetadataCache::getMetadata()
+// does, so the threshold monitors can be answered from a trace instead
+using SensorMetadataLookup = std::function<void(
+    const std::string& owner, const std::string& path,
+    const std::string& thresholdInterface, const std::string& threshold,
+    SensorMetadataCache::MetadataHandler&& handler)>;
+
+// The metadata a threshold monitor was given for a sensor, as it is traced
+struct SensorMetadataReply
+{
+    static constexpr SelTraceKind traceKind = SelTraceKind::sensorMetadata;
+
+    std::string path;
+    std::string threshold;
+    std::optional<double> max;
+    std::optional<double> min;
+    std::optional<double> scale;
+    std::optional<double> thresholdValue;
+
+    template <typename Self>
+    static auto traceFields(Self& self)
+    {
+        return std::tie(self.path, self.threshold, self.max, self.min,
+                        self.scale, self.thresholdValue);
+    }
+
+    std::optional<SensorValueProperties> sensorValue() const
+    {
+        if (!max || !min)
+        {
+            return std::nullopt;
+        }
+        return SensorValueProperties{*max, *min, scale};
+    }
+};
+
+// Look up metadata in a cache, capturing every answer
+inline SensorMetadataLookup sensorCacheLookup(
+    std::shared_ptr<SensorMetadataCache> sensorCache)
+{
+    return [sensorCache](const std::string& owner, const std::string& path,
+                         const std::string& thresholdInterface,
+                         const std::string& threshold,
+                         SensorMetadataCache::MetadataHandler&& handler) {
+#ifdef SEL_LOGGER_TRACE
+        handler = [path, threshold, handler = std::move(handler)](
+                      std::optional<SensorValueProperties> sensorValue,
+                      std::optional<double> thresholdValue) {
+            SensorMetadataReply reply;
+            reply.path = path;
+            reply.threshold = threshold;
+            if (sensorValue)
+            {
+                reply.max = sensorValue->max;
+                reply.min = sensorValue->min;
+                reply.scale = sensorValue->scale;
+            }
+            reply.thresholdValue = thresholdValue;
+            selTraceEvent(reply);
+            handler(sensorValue, thresholdValue);
+        };
+#endif
+        sensorCache->getMetadata(owner, path, thresholdInterface, threshold,
+                                 std::move(handler));
+    };
+}
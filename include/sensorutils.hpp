@@ -15,9 +15,15 @@
 */
 
 #pragma once
+#include <boost/container/flat_map.hpp>
+
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <utility>
 
 namespace ipmi
 {
@@ -41,6 +47,29 @@ static constexpr int16_t minInt10 = -0x200;
 static constexpr int8_t maxInt4 = 7;
 static constexpr int8_t minInt4 = -8;
 
+// Powers of ten for every exponent the scaling math can use: rExp and bExp
+// are in [minInt4, maxInt4], so their sums and negations stay within +/-16.
+// The values are computed with std::pow, so using the table gives exactly
+// the same results as calling std::pow.
+static constexpr int pow10TableMax = 2 * -minInt4;
+
+inline double pow10(int exponent)
+{
+    static const std::array<double, 2 * pow10TableMax + 1> table = []() {
+        std::array<double, 2 * pow10TableMax + 1> values{};
+        for (int i = -pow10TableMax; i <= pow10TableMax; i++)
+        {
+            values[i + pow10TableMax] = std::pow(10.0, i);
+        }
+        return values;
+    }();
+    if (exponent < -pow10TableMax || exponent > pow10TableMax)
+    {
+        return std::pow(10.0, exponent);
+    }
+    return table[exponent + pow10TableMax];
+}
+
 // Helper function to avoid repeated complicated expression
 // TODO(): Refactor to add a proper sensorutils.cpp file,
 // instead of putting everything in this header as it is now,
@@ -256,8 +285,7 @@ static inline bool getSensorAttributes(
     // B = 10^(-rExp - bExp) (y - M 10^rExp x)
     // TODO(): Compare with this alternative solution from SageMathCell
     // https://sagecell.sagemath.org/?z=eJyrtC1LLNJQr1TX5KqAMCuATF8I0xfIdIIwnYDMIteKAggPxAIKJMEFkiACxfk5Zaka0ZUKtrYKGhq-CloKFZoK2goaTkCWhqGBgpaWAkilpqYmQgBklmasjoKTJgDAECTH&lang=sage&interacts=eJyLjgUAARUAuQ==
-    double dB = std::pow(10.0, ((-rExp) - bExp)) *
-                (min - ((dM * std::pow(10.0, rExp) * lowestX)));
+    double dB = pow10((-rExp) - bExp) * (min - ((dM * pow10(rExp) * lowestX)));
 
     // Step 4: Constrain B, and set bExp accordingly
     if (!(scaleFloatExp(dB, bExp)))
@@ -294,9 +322,7 @@ static inline uint8_t scaleIPMIValueFromDouble(
     // x = (10^(-rExp) (y - B 10^(rExp + bExp)))/M and M 10^rExp!=0
     // TODO(): Compare with this alternative solution from SageMathCell
     // https://sagecell.sagemath.org/?z=eJyrtC1LLNJQr1TX5KqAMCuATF8I0xfIdIIwnYDMIteKAggPxAIKJMEFkiACxfk5Zaka0ZUKtrYKGhq-CloKFZoK2goaTkCWhqGBgpaWAkilpqYmQgBklmasDlAlAMB8JP0=&lang=sage&interacts=eJyLjgUAARUAuQ==
-    double dX =
-        (std::pow(10.0, -rExp) * (value - (dB * std::pow(10.0, rExp + bExp)))) /
-        dM;
+    double dX = (pow10(-rExp) * (value - (dB * pow10(rExp + bExp)))) / dM;
 
     auto scaledValue = static_cast<int32_t>(std::round(dX));
 
@@ -324,23 +350,131 @@ static inline uint8_t scaleIPMIValueFromDouble(
     return static_cast<uint8_t>(clampedValue);
 }
 
+/** @struct ScalingFactors
+ *  @brief The IPMI linear conversion for a sensor range, with the parts of
+ *  scaleIPMIValueFromDouble() that don't depend on the reading precomputed
+ */
+struct ScalingFactors
+{
+    int16_t mValue;
+    int8_t rExp;
+    int16_t bValue;
+    int8_t bExp;
+    bool bSigned;
+    // 10^-rExp and B * 10^(rExp + bExp)
+    double readingScale;
+    double readingOffset;
+
+    uint8_t scale(const double value) const
+    {
+        // Same operations in the same order as scaleIPMIValueFromDouble(),
+        // so the result is identical
+        double dX = (readingScale * (value - readingOffset)) /
+                    static_cast<double>(mValue);
+
+        auto scaledValue = static_cast<int32_t>(std::round(dX));
+        if (bSigned)
+        {
+            return static_cast<uint8_t>(
+                std::clamp<int32_t>(scaledValue,
+                                    std::numeric_limits<int8_t>::lowest(),
+                                    std::numeric_limits<int8_t>::max()));
+        }
+        return static_cast<uint8_t>(
+            std::clamp<int32_t>(scaledValue,
+                                std::numeric_limits<uint8_t>::lowest(),
+                                std::numeric_limits<uint8_t>::max()));
+    }
+};
+
+// Get the scaling factors for a sensor range, which only has to be worked
+// out once per (min, max) pair.  Empty if the range can't be represented.
+// Not static, so every translation unit shares the one cache.
+inline std::optional<ScalingFactors> getScalingFactors(
+    const double max, const double min)
+{
+    // Sensors only have a handful of distinct ranges, the limit is only
+    // there so something unexpected can't grow the cache forever
+    static constexpr size_t maxCachedRanges = 256;
+    static boost::container::flat_map<std::pair<double, double>,
+                                      std::optional<ScalingFactors>>
+        cache;
+
+    // NaN can't be used as a key, and is rejected by getSensorAttributes()
+    // anyway
+    bool cacheable = !std::isnan(max) && !std::isnan(min);
+    if (cacheable)
+    {
+        auto findRange = cache.find(std::make_pair(min, max));
+        if (findRange != cache.end())
+        {
+            return findRange->second;
+        }
+    }
+
+    std::optional<ScalingFactors> factors;
+    ScalingFactors computed{};
+    if (getSensorAttributes(max, min, computed.mValue, computed.rExp,
+                            computed.bValue, computed.bExp, computed.bSigned))
+    {
+        computed.readingScale = pow10(-computed.rExp);
+        computed.readingOffset = static_cast<double>(computed.bValue) *
+                                 pow10(computed.rExp + computed.bExp);
+        factors = computed;
+    }
+
+    if (cacheable)
+    {
+        if (cache.size() >= maxCachedRanges)
+        {
+            cache.clear();
+        }
+        cache.emplace(std::make_pair(min, max), factors);
+    }
+    return factors;
+}
+
 static inline uint8_t getScaledIPMIValue(const double value, const double max,
                                          const double min)
 {
-    int16_t mValue = 0;
-    int8_t rExp = 0;
-    int16_t bValue = 0;
-    int8_t bExp = 0;
-    bool bSigned = false;
-
-    bool result =
-        getSensorAttributes(max, min, mValue, rExp, bValue, bExp, bSigned);
-    if (!result)
+    std::optional<ScalingFactors> factors = getScalingFactors(max, min);
+    if (!factors)
     {
         throw std::runtime_error("Illegal sensor attributes");
     }
 
-    return scaleIPMIValueFromDouble(value, mValue, rExp, bValue, bExp, bSigned);
+    return factors->scale(value);
+}
+
+static constexpr uint8_t sensorTypeUnspecified = 0xFF;
+
+// Get the IPMI sensor type of a sensor from the type directory of its path,
+// /xyz/openbmc_project/sensors/<type>/<name>, the way ipmid's SDR does
+static inline uint8_t getSensorTypeFromPath(std::string_view path)
+{
+    static constexpr std::array<std::pair<std::string_view, uint8_t>, 6>
+        sensorTypes{{{"temperature", 0x01},
+                     {"voltage", 0x02},
+                     {"current", 0x03},
+                     {"fan_tach", 0x04},
+                     {"fan_pwm", 0x04},
+                     {"power", 0x0B}}};
+
+    size_t nameStart = path.find_last_of('/');
+    if (nameStart == std::string_view::npos)
+    {
+        return sensorTypeUnspecified;
+    }
+    path.remove_suffix(path.size() - nameStart);
+    path.remove_prefix(std::min(path.find_last_of('/') + 1, path.size()));
+    for (const auto& [name, sensorType] : sensorTypes)
+    {
+        if (name == path)
+        {
+            return sensorType;
+        }
+    }
+    return sensorTypeUnspecified;
 }
 
 } // namespace ipmi
@@ -18,246 +18,167 @@
 #include "threshold_event_monitor.hpp"
 
 #include <boost/container/flat_map.hpp>
+#include <flap_suppressor.hpp>
 #include <sdbusplus/bus/match.hpp>
 #include <sel_logger.hpp>
 #include <sensorutils.hpp>
 
-#include <map>
+#include <algorithm>
+#include <array>
+#include <string>
 #include <string_view>
+#include <tuple>
 #include <variant>
 
+// One match per threshold interface covers all of its alarm signals
 using sdbusMatch = std::shared_ptr<sdbusplus::match>;
-static sdbusMatch warningLowAssertedMatcher;
-static sdbusMatch warningLowDeassertedMatcher;
-static sdbusMatch warningHighAssertedMatcher;
-static sdbusMatch warningHighDeassertedMatcher;
-static sdbusMatch criticalLowAssertedMatcher;
-static sdbusMatch criticalLowDeassertedMatcher;
-static sdbusMatch criticalHighAssertedMatcher;
-static sdbusMatch criticalHighDeassertedMatcher;
+static std::array<sdbusMatch, 2> thresholdAlarmMatches;
 
-static boost::container::flat_map<std::string, sdbusMatch> matchers = {
-    {"WarningLowAlarmAsserted", warningLowAssertedMatcher},
-    {"WarningLowAlarmDeasserted", warningLowDeassertedMatcher},
-    {"WarningHighAlarmAsserted", warningHighAssertedMatcher},
-    {"WarningHighAlarmDeasserted", warningHighDeassertedMatcher},
-    {"CriticalLowAlarmAsserted", criticalLowAssertedMatcher},
-    {"CriticalLowAlarmDeasserted", criticalLowDeassertedMatcher},
-    {"CriticalHighAlarmAsserted", criticalHighAssertedMatcher},
-    {"CriticalHighAlarmDeasserted", criticalHighDeassertedMatcher}};
-
-void generateEvent(std::string signalName,
-                   std::shared_ptr<sdbusplus::asio::connection> conn,
-                   sdbusplus::message_t& msg)
+// An alarm signal of a threshold interface, and who sent it
+struct ThresholdAlarmSignal
 {
-    double assertValue;
-    try
-    {
-        msg.read(assertValue);
-    }
-    catch (const sdbusplus::exception_t&)
-    {
-        std::cerr << "error getting assert signal data from " << msg.get_path()
-                  << "\n";
-        return;
-    }
+    static constexpr SelTraceKind traceKind = SelTraceKind::thresholdAlarm;
 
-    std::string event;
-    std::string thresholdInterface;
-    std::string threshold;
-    std::string direction;
-    bool assert = false;
-    std::vector<uint8_t> eventData(selEvtDataMaxSize, selEvtDataUnspecified);
-    std::string redfishMessageID = "OpenBMC." + openBMCMessageRegistryVersion;
+    std::string path;
+    std::string sender;
+    // The signal name, e.g. WarningLowAlarmAsserted
+    std::string member;
+    double assertValue = 0;
 
-    if (signalName == "WarningLowAlarmAsserted" ||
-        signalName == "WarningLowAlarmDeasserted")
-    {
-        event = "WarningLow";
-        thresholdInterface = "xyz.openbmc_project.Sensor.Threshold.Warning";
-        eventData[0] =
-            static_cast<uint8_t>(thresholdEventOffsets::lowerNonCritGoingLow);
-        threshold = "warning low";
-        if (signalName == "WarningLowAlarmAsserted")
-        {
-            assert = true;
-            direction = "low";
-            redfishMessageID += ".SensorThresholdWarningLowGoingLow";
-        }
-        else if (signalName == "WarningLowAlarmDeasserted")
-        {
-            direction = "high";
-            redfishMessageID += ".SensorThresholdWarningLowGoingHigh";
-        }
-    }
-    else if (signalName == "WarningHighAlarmAsserted" ||
-             signalName == "WarningHighAlarmDeasserted")
-    {
-        event = "WarningHigh";
-        thresholdInterface = "xyz.openbmc_project.Sensor.Threshold.Warning";
-        eventData[0] =
-            static_cast<uint8_t>(thresholdEventOffsets::upperNonCritGoingHigh);
-        threshold = "warning high";
-        if (signalName == "WarningHighAlarmAsserted")
-        {
-            assert = true;
-            direction = "high";
-            redfishMessageID += ".SensorThresholdWarningHighGoingHigh";
-        }
-        else if (signalName == "WarningHighAlarmDeasserted")
-        {
-            direction = "low";
-            redfishMessageID += ".SensorThresholdWarningHighGoingLow";
-        }
-    }
-    else if (signalName == "CriticalLowAlarmAsserted" ||
-             signalName == "CriticalLowAlarmDeasserted")
-    {
-        event = "CriticalLow";
-        thresholdInterface = "xyz.openbmc_project.Sensor.Threshold.Critical";
-        eventData[0] =
-            static_cast<uint8_t>(thresholdEventOffsets::lowerCritGoingLow);
-        threshold = "critical low";
-        if (signalName == "CriticalLowAlarmAsserted")
-        {
-            assert = true;
-            direction = "low";
-            redfishMessageID += ".SensorThresholdCriticalLowGoingLow";
-        }
-        else if (signalName == "CriticalLowAlarmDeasserted")
-        {
-            direction = "high";
-            redfishMessageID += ".SensorThresholdCriticalLowGoingHigh";
-        }
-    }
-    else if (signalName == "CriticalHighAlarmAsserted" ||
-             signalName == "CriticalHighAlarmDeasserted")
+    template <typename Self>
+    static auto traceFields(Self& self)
     {
-        event = "CriticalHigh";
-        thresholdInterface = "xyz.openbmc_project.Sensor.Threshold.Critical";
-        eventData[0] =
-            static_cast<uint8_t>(thresholdEventOffsets::upperCritGoingHigh);
-        threshold = "critical high";
-        if (signalName == "CriticalHighAlarmAsserted")
-        {
-            assert = true;
-            direction = "high";
-            redfishMessageID += ".SensorThresholdCriticalHighGoingHigh";
-        }
-        else if (signalName == "CriticalHighAlarmDeasserted")
-        {
-            direction = "low";
-            redfishMessageID += ".SensorThresholdCriticalHighGoingLow";
-        }
+        return std::tie(self.path, self.sender, self.member, self.assertValue);
     }
+};
+
+void generateEvent(const ThresholdEventDescriptor& descriptor, bool assert,
+                   std::shared_ptr<sdbusplus::asio::connection> conn,
+                   const SensorMetadataLookup& getMetadata,
+                   std::shared_ptr<FlapSuppressor> flapSuppressor,
+                   const ThresholdAlarmSignal& signal)
+{
+    double assertValue = signal.assertValue;
+
+    SelEventData eventData;
+    eventData.fill(selEvtDataUnspecified);
+    eventData[0] = static_cast<uint8_t>(descriptor.offset);
+
     // Indicate that bytes 2 and 3 are threshold sensor trigger values
     eventData[0] |= thresholdEventDataTriggerReadingByte2 |
                     thresholdEventDataTriggerReadingByte3;
 
-    // Get the sensor reading to put in the event data
-    sdbusplus::message_t getSensorValue =
-        conn->new_method_call(msg.get_sender(), msg.get_path(),
-                              "org.freedesktop.DBus.Properties", "GetAll");
-    getSensorValue.append("xyz.openbmc_project.Sensor.Value");
-    boost::container::flat_map<std::string, std::variant<double, int64_t>>
-        sensorValue;
-    try
-    {
-        sdbusplus::message_t getSensorValueResp = conn->call(getSensorValue);
-        getSensorValueResp.read(sensorValue);
-    }
-    catch (const sdbusplus::exception_t&)
-    {
-        std::cerr << "error getting sensor value from " << msg.get_path()
-                  << "\n";
-        return;
-    }
-    double max = 0;
-    auto findMax = sensorValue.find("MaxValue");
-    if (findMax != sensorValue.end())
-    {
-        max = std::visit(ipmi::VariantToDoubleVisitor(), findMax->second);
-    }
-    double min = 0;
-    auto findMin = sensorValue.find("MinValue");
-    if (findMin != sensorValue.end())
-    {
-        min = std::visit(ipmi::VariantToDoubleVisitor(), findMin->second);
-    }
-
-    try
-    {
-        eventData[1] = ipmi::getScaledIPMIValue(assertValue, max, min);
-    }
-    catch (const std::exception& e)
-    {
-        std::cerr << e.what();
-        eventData[1] = selEvtDataUnspecified;
-    }
+    // Get the sensor range and threshold value to put in the event data.
+    // This completes asynchronously if they are not already cached.
+    // Transitions of a flapping sensor are held back and summarized.
+    const std::string& path = signal.path;
+    const std::string& sender = signal.sender;
+    const ThresholdEventDescriptor* thresholdEvent = &descriptor;
+    auto log = [conn, getMetadata, sender, path, thresholdEvent, assert,
+                assertValue, eventData, event = selMetricsEvent]() {
+        getMetadata(
+            sender, path, thresholdEvent->interface, thresholdEvent->name,
+            [conn, path, thresholdEvent, assert, assertValue, eventData, event](
+                std::optional<SensorValueProperties> sensorValue,
+                std::optional<double> thresholdValue) mutable {
+                SelMetricsScope metricsScope(event);
+                reportMissingMetadata(path, sensorValue, thresholdValue);
+                fillThresholdEventData(eventData, assertValue, sensorValue,
+                                       thresholdValue);
+
+                std::string_view sensorName(path);
+                sensorName.remove_prefix(std::min(
+                    sensorName.find_last_of("/") + 1, sensorName.size()));
+
+                const ThresholdTransition& transition =
+                    thresholdEvent->transition(assert);
+                SelMessageBuffer journalMsg;
+                journalMsg.append(sensorName)
+                    .append(" sensor crossed a ")
+                    .append(thresholdEvent->description)
+                    .append(" threshold going ")
+                    .append(transition.direction)
+                    .append(". Reading=")
+                    .append(assertValue)
+                    .append(" Threshold=")
+                    .append(thresholdValue)
+                    .append('.');
+
+                SelJournalField<"REDFISH_MESSAGE_ARGS", 256>
+                    redfishMessageArgs;
+                redfishMessageArgs.append(sensorName)
+                    .append(',')
+                    .append(assertValue)
+                    .append(',')
+                    .append(thresholdValue);
+
+                selAddSystemRecord(conn, journalMsg.view(), path, eventData,
+                                   assert, selBMCGenID,
+                                   selThresholdSensorInfo(path),
+                                   transition.redfishMessageIdField,
+                                   redfishMessageArgs);
+            });
+    };
+    flapSuppressor->submit(path, descriptor.name, assert, std::move(log));
+}
 
-    // Get the threshold value to put in the event data
-    sdbusplus::message_t getThreshold =
-        conn->new_method_call(msg.get_sender(), msg.get_path(),
-                              "org.freedesktop.DBus.Properties", "Get");
-    getThreshold.append(thresholdInterface, event);
-    std::variant<double, int64_t> thresholdValue;
-    try
-    {
-        sdbusplus::message_t getThresholdResp = conn->call(getThreshold);
-        getThresholdResp.read(thresholdValue);
-    }
-    catch (const sdbusplus::exception_t&)
+// Log the threshold event of an alarm signal
+inline static void handleThresholdAlarm(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const SensorMetadataLookup& getMetadata,
+    const std::shared_ptr<FlapSuppressor>& flapSuppressor,
+    const ThresholdAlarmSignal& signal)
+{
+    // Other signals on the interface aren't alarms
+    std::optional<ThresholdEventMatch> match =
+        findThresholdEvent(ThresholdEventName::alarmSignal, signal.member);
+    if (!match)
     {
-        std::cerr << "error getting sensor threshold from " << msg.get_path()
-                  << "\n";
         return;
     }
-    double thresholdVal =
-        std::visit(ipmi::VariantToDoubleVisitor(), thresholdValue);
-
-    double scale = 0;
-    auto findScale = sensorValue.find("Scale");
-    if (findScale != sensorValue.end())
-    {
-        scale = std::visit(ipmi::VariantToDoubleVisitor(), findScale->second);
-        thresholdVal *= std::pow(10, scale);
-    }
-    try
-    {
-        eventData[2] = ipmi::getScaledIPMIValue(thresholdVal, max, min);
-    }
-    catch (const std::exception& e)
-    {
-        std::cerr << e.what();
-        eventData[2] = selEvtDataUnspecified;
-    }
-
-    std::string_view sensorName(msg.get_path());
-    sensorName.remove_prefix(
-        std::min(sensorName.find_last_of("/") + 1, sensorName.size()));
-
-    std::string journalMsg(std::string(sensorName) + " sensor crossed a " +
-                           threshold + " threshold going " + direction +
-                           ". Reading=" + std::to_string(assertValue) +
-                           " Threshold=" + std::to_string(thresholdVal) + ".");
-
-    selAddSystemRecord(conn, journalMsg, std::string(msg.get_path()), eventData,
-                       assert, selBMCGenID, "REDFISH_MESSAGE_ID=%s",
-                       redfishMessageID.c_str(),
-                       "REDFISH_MESSAGE_ARGS=%.*s,%f,%f", sensorName.length(),
-                       sensorName.data(), assertValue, thresholdVal);
+    SelMetricsScope metricsScope(SelMetricSource::thresholdAlarm);
+    generateEvent(*match->descriptor, match->assert, conn, getMetadata,
+                  flapSuppressor, signal);
 }
 
 inline static void startThresholdAlarmMonitor(
-    std::shared_ptr<sdbusplus::asio::connection> conn)
+    std::shared_ptr<sdbusplus::asio::connection> conn,
+    std::shared_ptr<SensorMetadataCache> sensorCache,
+    std::shared_ptr<FlapSuppressor> flapSuppressor)
 {
-    for (auto iter = matchers.begin(); iter != matchers.end(); iter++)
+    std::array<const char*, 2> interfaces{
+        "xyz.openbmc_project.Sensor.Threshold.Warning",
+        "xyz.openbmc_project.Sensor.Threshold.Critical"};
+    SensorMetadataLookup getMetadata = sensorCacheLookup(sensorCache);
+    for (size_t i = 0; i < interfaces.size(); i++)
     {
-        iter->second = std::make_shared<sdbusplus::match>(
+        thresholdAlarmMatches[i] = std::make_shared<sdbusplus::match>(
             static_cast<sdbusplus::bus_t&>(*conn),
-            "type='signal',member=" + iter->first,
-            [conn, iter](sdbusplus::message_t& msg) {
-                generateEvent(iter->first, conn, msg);
+            "type='signal',interface='" + std::string(interfaces[i]) + "'",
+            [conn, getMetadata, flapSuppressor](sdbusplus::message_t& msg) {
+                // Only alarm signals are traced
+                if (!findThresholdEvent(ThresholdEventName::alarmSignal,
+                                        msg.get_member()))
+                {
+                    return;
+                }
+                ThresholdAlarmSignal signal;
+                try
+                {
+                    msg.read(signal.assertValue);
+                }
+                catch (const sdbusplus::exception_t&)
+                {
+                    std::cerr << "error getting assert signal data from "
+                              << msg.get_path() << "\n";
+                    return;
+                }
+                signal.path = msg.get_path();
+                signal.sender = msg.get_sender();
+                signal.member = msg.get_member();
+                selTraceEvent(signal);
+                handleThresholdAlarm(conn, getMetadata, flapSuppressor,
+                                     signal);
             });
     }
 }
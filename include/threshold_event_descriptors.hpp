@@ -0,0 +1,260 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <asserted_events.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string_view>
+
+enum class thresholdEventOffsets : uint8_t
+{
+    lowerNonCritGoingLow = 0x00,
+    lowerCritGoingLow = 0x02,
+    upperNonCritGoingHigh = 0x07,
+    upperCritGoingHigh = 0x09,
+};
+
+static constexpr std::string_view openBMCMessageRegistryVersion = "0.1";
+
+enum class ThresholdSeverity : uint8_t
+{
+    informational,
+    warning,
+    critical,
+};
+
+// What is logged when a threshold is crossed in one direction
+struct ThresholdTransition
+{
+    std::string_view direction;
+    std::string_view redfishMessage;
+    // The complete REDFISH_MESSAGE_ID journal field
+    std::string_view redfishMessageIdField;
+    ThresholdSeverity severity;
+};
+
+// Everything about one threshold that is fixed at compile time
+struct ThresholdEventDescriptor
+{
+    // Threshold property, e.g. WarningLow
+    const char* name;
+    // Alarm property, e.g. WarningAlarmLow
+    const char* alarm;
+    const char* interface;
+    // Used in messages, e.g. "warning low"
+    std::string_view description;
+    thresholdEventOffsets offset;
+    AssertedEvent assertedEvent;
+    ThresholdTransition asserted;
+    ThresholdTransition deasserted;
+
+    const ThresholdTransition& transition(bool assert) const
+    {
+        return assert ? asserted : deasserted;
+    }
+};
+
+static constexpr std::array<ThresholdEventDescriptor, 4>
+    thresholdEventDescriptors{{
+        {"WarningLow",
+         "WarningAlarmLow",
+         "xyz.openbmc_project.Sensor.Threshold.Warning",
+         "warning low",
+         thresholdEventOffsets::lowerNonCritGoingLow,
+         AssertedEvent::warningLow,
+         {"low", "SensorThresholdWarningLowGoingLow",
+          "REDFISH_MESSAGE_ID=OpenBMC.0.1.SensorThresholdWarningLowGoingLow",
+          ThresholdSeverity::warning},
+         {"high", "SensorThresholdWarningLowGoingHigh",
+          "REDFISH_MESSAGE_ID=OpenBMC.0.1.SensorThresholdWarningLowGoingHigh",
+          ThresholdSeverity::informational}},
+        {"WarningHigh",
+         "WarningAlarmHigh",
+         "xyz.openbmc_project.Sensor.Threshold.Warning",
+         "warning high",
+         thresholdEventOffsets::upperNonCritGoingHigh,
+         AssertedEvent::warningHigh,
+         {"high", "SensorThresholdWarningHighGoingHigh",
+          "REDFISH_MESSAGE_ID=OpenBMC.0.1.SensorThresholdWarningHighGoingHigh",
+          ThresholdSeverity::warning},
+         {"low", "SensorThresholdWarningHighGoingLow",
+          "REDFISH_MESSAGE_ID=OpenBMC.0.1.SensorThresholdWarningHighGoingLow",
+          ThresholdSeverity::informational}},
+        {"CriticalLow",
+         "CriticalAlarmLow",
+         "xyz.openbmc_project.Sensor.Threshold.Critical",
+         "critical low",
+         thresholdEventOffsets::lowerCritGoingLow,
+         AssertedEvent::criticalLow,
+         {"low", "SensorThresholdCriticalLowGoingLow",
+          "REDFISH_MESSAGE_ID=OpenBMC.0.1.SensorThresholdCriticalLowGoingLow",
+          ThresholdSeverity::critical},
+         {"high", "SensorThresholdCriticalLowGoingHigh",
+          "REDFISH_MESSAGE_ID=OpenBMC.0.1.SensorThresholdCriticalLowGoingHigh",
+          ThresholdSeverity::informational}},
+        {"CriticalHigh",
+         "CriticalAlarmHigh",
+         "xyz.openbmc_project.Sensor.Threshold.Critical",
+         "critical high",
+         thresholdEventOffsets::upperCritGoingHigh,
+         AssertedEvent::criticalHigh,
+         {"high", "SensorThresholdCriticalHighGoingHigh",
+          "REDFISH_MESSAGE_ID=OpenBMC.0.1.SensorThresholdCriticalHighGoingHigh",
+          ThresholdSeverity::critical},
+         {"low", "SensorThresholdCriticalHighGoingLow",
+          "REDFISH_MESSAGE_ID=OpenBMC.0.1.SensorThresholdCriticalHighGoingLow",
+          ThresholdSeverity::informational}},
+    }};
+
+// The precomputed message IDs have to match the registry version and message
+static_assert([]() {
+    for (const ThresholdEventDescriptor& descriptor : thresholdEventDescriptors)
+    {
+        for (const ThresholdTransition* transition :
+             {&descriptor.asserted, &descriptor.deasserted})
+        {
+            std::string_view field = transition->redfishMessageIdField;
+            constexpr std::string_view prefix = "REDFISH_MESSAGE_ID=OpenBMC.";
+            if (!field.starts_with(prefix))
+            {
+                return false;
+            }
+            field.remove_prefix(prefix.size());
+            if (!field.starts_with(openBMCMessageRegistryVersion))
+            {
+                return false;
+            }
+            field.remove_prefix(openBMCMessageRegistryVersion.size());
+            if (!field.starts_with('.') ||
+                field.substr(1) != transition->redfishMessage)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}());
+
+// The names a threshold event is known by in the different D-Bus signals
+enum class ThresholdEventName : uint8_t
+{
+    // The event argument of ThresholdAsserted, e.g. WarningAlarmLow
+    alarm,
+    // An alarm signal member, e.g. WarningLowAlarmAsserted
+    alarmSignal,
+};
+
+struct ThresholdEventMatch
+{
+    const ThresholdEventDescriptor* descriptor;
+    // Only known for alarm signals, which say it in their name
+    bool assert;
+};
+
+namespace threshold_event_detail
+{
+struct Key
+{
+    std::string_view name;
+    ThresholdEventName kind;
+    uint8_t descriptor;
+    bool assert;
+};
+
+static constexpr std::array<Key, 12> keys{{
+    {"WarningAlarmLow", ThresholdEventName::alarm, 0, false},
+    {"WarningAlarmHigh", ThresholdEventName::alarm, 1, false},
+    {"CriticalAlarmLow", ThresholdEventName::alarm, 2, false},
+    {"CriticalAlarmHigh", ThresholdEventName::alarm, 3, false},
+    {"WarningLowAlarmAsserted", ThresholdEventName::alarmSignal, 0, true},
+    {"WarningLowAlarmDeasserted", ThresholdEventName::alarmSignal, 0, false},
+    {"WarningHighAlarmAsserted", ThresholdEventName::alarmSignal, 1, true},
+    {"WarningHighAlarmDeasserted", ThresholdEventName::alarmSignal, 1, false},
+    {"CriticalLowAlarmAsserted", ThresholdEventName::alarmSignal, 2, true},
+    {"CriticalLowAlarmDeasserted", ThresholdEventName::alarmSignal, 2, false},
+    {"CriticalHighAlarmAsserted", ThresholdEventName::alarmSignal, 3, true},
+    {"CriticalHighAlarmDeasserted", ThresholdEventName::alarmSignal, 3, false},
+}};
+
+static constexpr size_t slotCount = 32;
+static constexpr uint8_t emptySlot = 0xFF;
+
+// FNV-1a, with the seed mixed into the offset basis
+constexpr uint32_t hash(uint32_t seed, std::string_view name)
+{
+    uint32_t value = 2166136261u ^ seed;
+    for (char c : name)
+    {
+        value = (value ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return value;
+}
+
+struct PerfectHash
+{
+    bool found = false;
+    uint32_t seed = 0;
+    std::array<uint8_t, slotCount> slots{};
+};
+
+// Find a seed that gives every key a slot of its own
+constexpr PerfectHash findPerfectHash()
+{
+    for (uint32_t seed = 0; seed < 100000; seed++)
+    {
+        PerfectHash perfectHash{true, seed, {}};
+        perfectHash.slots.fill(emptySlot);
+        bool collision = false;
+        for (size_t i = 0; i < keys.size() && !collision; i++)
+        {
+            uint8_t& slot =
+                perfectHash.slots[hash(seed, keys[i].name) % slotCount];
+            collision = slot != emptySlot;
+            slot = static_cast<uint8_t>(i);
+        }
+        if (!collision)
+        {
+            return perfectHash;
+        }
+    }
+    return PerfectHash{};
+}
+
+static constexpr PerfectHash perfectHash = findPerfectHash();
+static_assert(perfectHash.found,
+              "no perfect hash seed found for the threshold event names");
+} // namespace threshold_event_detail
+
+// Look up a threshold event by one of its names with a single hash and a
+// single string comparison
+inline std::optional<ThresholdEventMatch> findThresholdEvent(
+    ThresholdEventName kind, std::string_view name)
+{
+    using namespace threshold_event_detail;
+    uint8_t slot = perfectHash.slots[hash(perfectHash.seed, name) % slotCount];
+    if (slot == emptySlot || keys[slot].kind != kind || keys[slot].name != name)
+    {
+        return std::nullopt;
+    }
+    const Key& key = keys[slot];
+    return ThresholdEventMatch{&thresholdEventDescriptors[key.descriptor],
+                               key.assert};
+}
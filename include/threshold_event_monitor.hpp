@@ -15,328 +15,364 @@
 */
 
 #pragma once
+#include <asserted_events.hpp>
 #include <boost/container/flat_map.hpp>
-#include <boost/container/flat_set.hpp>
+#include <flap_suppressor.hpp>
+#include <monitor_state_snapshot.hpp>
 #include <sdbusplus/bus/match.hpp>
 #include <sel_logger.hpp>
+#include <sensor_metadata_cache.hpp>
 #include <sensorutils.hpp>
+#include <threshold_event_descriptors.hpp>
 
+#include <array>
+#include <string>
 #include <string_view>
+#include <tuple>
 #include <variant>
 
-enum class thresholdEventOffsets : uint8_t
-{
-    lowerNonCritGoingLow = 0x00,
-    lowerCritGoingLow = 0x02,
-    upperNonCritGoingHigh = 0x07,
-    upperCritGoingHigh = 0x09,
-};
-
 static constexpr const uint8_t thresholdEventDataTriggerReadingByte2 = (1 << 6);
 static constexpr const uint8_t thresholdEventDataTriggerReadingByte3 = (1 << 4);
 
-static const std::string openBMCMessageRegistryVersion("0.1");
-
-inline static sdbusplus::match startThresholdAssertMonitor(
-    std::shared_ptr<sdbusplus::asio::connection> conn)
+// Fill in the reading and threshold bytes of a threshold event.  Without the
+// sensor range, or the threshold value, the bytes that need them are left
+// unspecified.
+inline static void fillThresholdEventData(
+    SelEventData& eventData, const std::optional<double>& assertValue,
+    const std::optional<SensorValueProperties>& sensorValue,
+    std::optional<double>& thresholdValue)
 {
-    auto thresholdAssertMatcherCallback = [conn](sdbusplus::message_t& msg) {
-        // This static set of std::pair<path, event> tracks asserted events to
-        // avoid duplicate logs or deasserts logged without an assert
-        static boost::container::flat_set<std::pair<std::string, std::string>>
-            assertedEvents;
-        std::vector<uint8_t> eventData(selEvtDataMaxSize,
-                                       selEvtDataUnspecified);
+    if (thresholdValue && sensorValue && sensorValue->scale)
+    {
+        *thresholdValue *= std::pow(10, *sensorValue->scale);
+    }
+    if (!sensorValue)
+    {
+        eventData[0] &= ~(thresholdEventDataTriggerReadingByte2 |
+                          thresholdEventDataTriggerReadingByte3);
+        return;
+    }
 
-        // Get the event type and assertion details from the message
-        std::string sensorName;
-        std::string thresholdInterface;
-        std::string event;
-        bool assert;
-        double assertValue;
+    double max = sensorValue->max;
+    double min = sensorValue->min;
+    if (!assertValue)
+    {
+        eventData[0] &= ~thresholdEventDataTriggerReadingByte2;
+    }
+    else
+    {
         try
         {
-            msg.read(sensorName, thresholdInterface, event, assert,
-                     assertValue);
+            eventData[1] = ipmi::getScaledIPMIValue(*assertValue, max, min);
         }
-        catch (const sdbusplus::exception_t&)
+        catch (const std::exception& e)
         {
-            std::cerr << "error getting assert signal data from "
-                      << msg.get_path() << "\n";
-            return;
+            std::cerr << e.what();
+            eventData[1] = selEvtDataUnspecified;
         }
+    }
 
-        // Check the asserted events to determine if we should log this event
-        std::pair<std::string, std::string> pathAndEvent(
-            std::string(msg.get_path()), event);
-        if (assert)
-        {
-            // For asserts, add the event to the set and only log it if it's new
-            if (assertedEvents.insert(pathAndEvent).second == false)
-            {
-                // event is already in the set
-                return;
-            }
-        }
-        else
-        {
-            // For deasserts, remove the event and only log the deassert if it
-            // was asserted
-            if (assertedEvents.erase(pathAndEvent) == 0)
-            {
-                // asserted event was not in the set
-                return;
-            }
-        }
+    if (!thresholdValue)
+    {
+        eventData[0] &= ~thresholdEventDataTriggerReadingByte3;
+        return;
+    }
+    try
+    {
+        eventData[2] = ipmi::getScaledIPMIValue(*thresholdValue, max, min);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what();
+        eventData[2] = selEvtDataUnspecified;
+    }
+}
 
-        // Set the IPMI threshold event type based on the event details from the
-        // message
-        if (event == "CriticalAlarmLow")
-        {
-            eventData[0] =
-                static_cast<uint8_t>(thresholdEventOffsets::lowerCritGoingLow);
-        }
-        else if (event == "WarningAlarmLow")
-        {
-            eventData[0] = static_cast<uint8_t>(
-                thresholdEventOffsets::lowerNonCritGoingLow);
-        }
-        else if (event == "WarningAlarmHigh")
-        {
-            eventData[0] = static_cast<uint8_t>(
-                thresholdEventOffsets::upperNonCritGoingHigh);
-        }
-        else if (event == "CriticalAlarmHigh")
-        {
-            eventData[0] =
-                static_cast<uint8_t>(thresholdEventOffsets::upperCritGoingHigh);
-        }
-        // Indicate that bytes 2 and 3 are threshold sensor trigger values
-        eventData[0] |= thresholdEventDataTriggerReadingByte2 |
-                        thresholdEventDataTriggerReadingByte3;
+// Report a threshold event being logged without the sensor range or threshold
+// value, because they could not be read or not in time
+inline static void reportMissingMetadata(
+    const std::string& path,
+    const std::optional<SensorValueProperties>& sensorValue,
+    const std::optional<double>& thresholdValue)
+{
+    if (!sensorValue)
+    {
+        std::cerr << "error getting sensor value from " << path << "\n";
+    }
+    else if (!thresholdValue)
+    {
+        std::cerr << "error getting sensor threshold from " << path << "\n";
+    }
+    else
+    {
+        return;
+    }
+    selMetricsFailed();
+    selMetricsFallback();
+}
 
-        // Get the sensor reading to put in the event data
-        sdbusplus::message_t getSensorValue =
-            conn->new_method_call(msg.get_sender(), msg.get_path(),
-                                  "org.freedesktop.DBus.Properties", "GetAll");
-        getSensorValue.append("xyz.openbmc_project.Sensor.Value");
-        boost::container::flat_map<std::string, std::variant<double, int64_t>>
-            sensorValue;
-        try
-        {
-            sdbusplus::message_t getSensorValueResp =
-                conn->call(getSensorValue);
-            getSensorValueResp.read(sensorValue);
-        }
-        catch (const sdbusplus::exception_t&)
+// Fill in the reading and threshold bytes of a threshold event and log it
+inline static void logThresholdAssertEvent(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const std::string& sensorName, const std::string& path,
+    const ThresholdEventDescriptor& descriptor, bool assert,
+    std::optional<double> assertValue, SelEventData eventData,
+    const std::optional<SensorValueProperties>& sensorValue,
+    std::optional<double> thresholdValue)
+{
+    fillThresholdEventData(eventData, assertValue, sensorValue,
+                           thresholdValue);
+
+    std::string_view threshold = descriptor.description;
+    const ThresholdTransition& transition = descriptor.transition(assert);
+
+    SelMessageBuffer journalMsg;
+    journalMsg.append(sensorName)
+        .append(' ')
+        .append(threshold)
+        .append(" threshold ")
+        .append(assert ? "assert" : "deassert")
+        .append(". Reading=")
+        .append(assertValue)
+        .append(" Threshold=")
+        .append(thresholdValue)
+        .append('.');
+
+#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+    std::string LogLevel;
+    switch (transition.severity)
+    {
+        case ThresholdSeverity::informational:
         {
-            std::cerr << "error getting sensor value from " << msg.get_path()
-                      << "\n";
-            return;
+            LogLevel = "xyz.openbmc_project.Logging.Entry.Level.Informational";
+            break;
         }
-        double max = 0;
-        auto findMax = sensorValue.find("MaxValue");
-        if (findMax != sensorValue.end())
+        case ThresholdSeverity::warning:
         {
-            max = std::visit(ipmi::VariantToDoubleVisitor(), findMax->second);
+            LogLevel = "xyz.openbmc_project.Logging.Entry.Level.Warning";
+            break;
         }
-        double min = 0;
-        auto findMin = sensorValue.find("MinValue");
-        if (findMin != sensorValue.end())
+        case ThresholdSeverity::critical:
         {
-            min = std::visit(ipmi::VariantToDoubleVisitor(), findMin->second);
+            LogLevel = "xyz.openbmc_project.Logging.Entry.Level.Critical";
+            break;
         }
+    }
+    createLogEntry(conn, std::string(journalMsg.view()), LogLevel,
+                   {{"SENSOR_PATH", path},
+                    {"EVENT", std::string(threshold)},
+                    {"DIRECTION", std::string(transition.direction)},
+                    {"THRESHOLD", thresholdValue
+                                      ? std::to_string(*thresholdValue)
+                                      : "unknown"},
+                    {"READING", assertValue ? std::to_string(*assertValue)
+                                            : "unknown"}});
+#else
+    SelJournalField<"REDFISH_MESSAGE_ARGS", 256> redfishMessageArgs;
+    redfishMessageArgs.append(sensorName)
+        .append(',')
+        .append(assertValue)
+        .append(',')
+        .append(thresholdValue);
+    selAddSystemRecord(conn, journalMsg.view(), path, eventData, assert,
+                       selBMCGenID, selThresholdSensorInfo(path),
+                       transition.redfishMessageIdField, redfishMessageArgs);
+#endif
+}
 
-        try
-        {
-            eventData[1] = ipmi::getScaledIPMIValue(assertValue, max, min);
-        }
-        catch (const std::exception& e)
-        {
-            std::cerr << e.what();
-            eventData[1] = selEvtDataUnspecified;
-        }
+// The arguments of a ThresholdAsserted signal, and who sent it
+struct ThresholdAssertedSignal
+{
+    static constexpr SelTraceKind traceKind = SelTraceKind::thresholdAsserted;
 
-        // Get the threshold value to put in the event data
-        // Get the threshold parameter by removing the "Alarm" text from the
-        // event string
-        std::string alarm("Alarm");
-        if (std::string::size_type pos = event.find(alarm);
-            pos != std::string::npos)
-        {
-            event.erase(pos, alarm.length());
-        }
-        sdbusplus::message_t getThreshold =
-            conn->new_method_call(msg.get_sender(), msg.get_path(),
-                                  "org.freedesktop.DBus.Properties", "Get");
-        getThreshold.append(thresholdInterface, event);
-        std::variant<double, int64_t> thresholdValue;
-        try
+    std::string path;
+    std::string sender;
+    std::string sensorName;
+    std::string thresholdInterface;
+    std::string event;
+    bool assert = false;
+    double assertValue = 0;
+
+    template <typename Self>
+    static auto traceFields(Self& self)
+    {
+        return std::tie(self.path, self.sender, self.sensorName,
+                        self.thresholdInterface, self.event, self.assert,
+                        self.assertValue);
+    }
+};
+
+inline static void handleThresholdAsserted(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const SensorMetadataLookup& getMetadata,
+    const std::shared_ptr<FlapSuppressor>& flapSuppressor,
+    const ThresholdAssertedSignal& signal)
+{
+    SelEventData eventData;
+    eventData.fill(selEvtDataUnspecified);
+
+    // Look up the threshold the event is about
+    std::optional<ThresholdEventMatch> match =
+        findThresholdEvent(ThresholdEventName::alarm, signal.event);
+    if (!match)
+    {
+        // Not a threshold this monitor knows how to log
+        return;
+    }
+    const ThresholdEventDescriptor& descriptor = *match->descriptor;
+    eventData[0] = static_cast<uint8_t>(descriptor.offset);
+    SelMetricsScope metricsScope(SelMetricSource::threshold);
+
+    // Track asserted events to avoid duplicate logs or deasserts logged
+    // without an assert
+    AssertedEventTracker& assertedEvents = getAssertedEvents();
+    if (signal.assert)
+    {
+        // For asserts, only log the event if it's new
+        if (!assertedEvents.setAsserted(signal.path, descriptor.assertedEvent))
         {
-            sdbusplus::message_t getThresholdResp = conn->call(getThreshold);
-            getThresholdResp.read(thresholdValue);
+            selMetricsSuppressed();
+            return;
         }
-        catch (const sdbusplus::exception_t&)
+    }
+    else
+    {
+        // For deasserts, only log the deassert if it was asserted
+        if (!assertedEvents.setDeasserted(signal.path,
+                                          descriptor.assertedEvent))
         {
-            std::cerr << "error getting sensor threshold from "
-                      << msg.get_path() << "\n";
+            selMetricsSuppressed();
             return;
         }
-        double thresholdVal =
-            std::visit(ipmi::VariantToDoubleVisitor(), thresholdValue);
+    }
 
-        double scale = 0;
-        auto findScale = sensorValue.find("Scale");
-        if (findScale != sensorValue.end())
-        {
-            scale =
-                std::visit(ipmi::VariantToDoubleVisitor(), findScale->second);
-            thresholdVal *= std::pow(10, scale);
-        }
-        try
-        {
-            eventData[2] = ipmi::getScaledIPMIValue(thresholdVal, max, min);
-        }
-        catch (const std::exception& e)
-        {
-            std::cerr << e.what();
-            eventData[2] = selEvtDataUnspecified;
-        }
+    // Indicate that bytes 2 and 3 are threshold sensor trigger values
+    eventData[0] |= thresholdEventDataTriggerReadingByte2 |
+                    thresholdEventDataTriggerReadingByte3;
 
-        std::string threshold;
-        std::string direction;
-        std::string redfishMessageID =
-            "OpenBMC." + openBMCMessageRegistryVersion;
-        enum EventType
-        {
-            eventNone,
-            eventInfo,
-            eventWarn,
-            eventErr
-        };
-        [[maybe_unused]] EventType eventType = eventNone;
-        if (event == "CriticalLow")
-        {
-            threshold = "critical low";
-            if (assert)
-            {
-                eventType = eventErr;
-                direction = "low";
-                redfishMessageID += ".SensorThresholdCriticalLowGoingLow";
-            }
-            else
-            {
-                eventType = eventInfo;
-                direction = "high";
-                redfishMessageID += ".SensorThresholdCriticalLowGoingHigh";
-            }
-        }
-        else if (event == "WarningLow")
-        {
-            threshold = "warning low";
-            if (assert)
+    // Get the sensor range and threshold value to put in the event data.
+    // This completes asynchronously if they are not already cached.
+    // Transitions of a flapping sensor are held back and summarized.
+    const ThresholdEventDescriptor* thresholdEvent = &descriptor;
+    auto log = [conn, getMetadata, signal, thresholdEvent, eventData,
+                event = selMetricsEvent]() {
+        getMetadata(
+            signal.sender, signal.path, signal.thresholdInterface,
+            thresholdEvent->name,
+            [conn, signal, thresholdEvent, eventData,
+             event](std::optional<SensorValueProperties> sensorValue,
+                    std::optional<double> thresholdValue) {
+                SelMetricsScope metricsScope(event);
+                reportMissingMetadata(signal.path, sensorValue,
+                                      thresholdValue);
+                logThresholdAssertEvent(conn, signal.sensorName, signal.path,
+                                        *thresholdEvent, signal.assert,
+                                        signal.assertValue, eventData,
+                                        sensorValue, thresholdValue);
+            });
+    };
+    flapSuppressor->submit(signal.path, descriptor.name, signal.assert,
+                           std::move(log));
+}
+
+inline static sdbusplus::match startThresholdAssertMonitor(
+    std::shared_ptr<sdbusplus::asio::connection> conn,
+    std::shared_ptr<SensorMetadataCache> sensorCache,
+    std::shared_ptr<FlapSuppressor> flapSuppressor)
+{
+    auto thresholdAssertMatcherCallback =
+        [conn, getMetadata = sensorCacheLookup(sensorCache),
+         flapSuppressor](sdbusplus::message_t& msg) {
+            // Get the event type and assertion details from the message
+            ThresholdAssertedSignal signal;
+            try
             {
-                eventType = eventWarn;
-                direction = "low";
-                redfishMessageID += ".SensorThresholdWarningLowGoingLow";
+                msg.read(signal.sensorName, signal.thresholdInterface,
+                         signal.event, signal.assert, signal.assertValue);
             }
-            else
+            catch (const sdbusplus::exception_t&)
             {
-                eventType = eventInfo;
-                direction = "high";
-                redfishMessageID += ".SensorThresholdWarningLowGoingHigh";
+                std::cerr << "error getting assert signal data from "
+                          << msg.get_path() << "\n";
+                return;
             }
-        }
-        else if (event == "WarningHigh")
+            signal.path = msg.get_path();
+            signal.sender = msg.get_sender();
+            selTraceEvent(signal);
+            handleThresholdAsserted(conn, getMetadata, flapSuppressor, signal);
+        };
+    sdbusplus::match thresholdAssertMatcher(
+        static_cast<sdbusplus::bus_t&>(*conn),
+        "type='signal', member='ThresholdAsserted'",
+        std::move(thresholdAssertMatcherCallback));
+    return thresholdAssertMatcher;
+}
+
+// After a restart, bring the restored asserted events up to date with the
+// current threshold alarms, logging any assert or deassert that was missed
+// while the daemon was down
+inline static void reconcileThresholdEvents(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const ManagedObjects& objects)
+{
+    AssertedEventTracker& assertedEvents = getAssertedEvents();
+    for (const auto& [objectPath, interfaces] : objects)
+    {
+        const std::string& path = objectPath.str;
+        std::optional<double> value =
+            getManagedDouble(interfaces, sensorValueInterface, "Value");
+        SensorValueProperties sensorValue;
+        sensorValue.max =
+            getManagedDouble(interfaces, sensorValueInterface, "MaxValue")
+                .value_or(0);
+        sensorValue.min =
+            getManagedDouble(interfaces, sensorValueInterface, "MinValue")
+                .value_or(0);
+        sensorValue.scale =
+            getManagedDouble(interfaces, sensorValueInterface, "Scale");
+
+        for (const ThresholdEventDescriptor& descriptor :
+             thresholdEventDescriptors)
         {
-            threshold = "warning high";
-            if (assert)
+            std::optional<bool> asserted = getManagedBool(
+                interfaces, descriptor.interface, descriptor.alarm);
+            if (!asserted || *asserted == assertedEvents.isAsserted(
+                                              path, descriptor.assertedEvent))
             {
-                eventType = eventWarn;
-                direction = "high";
-                redfishMessageID += ".SensorThresholdWarningHighGoingHigh";
+                continue;
             }
-            else
+            if (*asserted)
             {
-                eventType = eventInfo;
-                direction = "low";
-                redfishMessageID += ".SensorThresholdWarningHighGoingLow";
-            }
-        }
-        else if (event == "CriticalHigh")
-        {
-            threshold = "critical high";
-            if (assert)
-            {
-                eventType = eventErr;
-                direction = "high";
-                redfishMessageID += ".SensorThresholdCriticalHighGoingHigh";
+                assertedEvents.setAsserted(path, descriptor.assertedEvent);
             }
             else
             {
-                eventType = eventInfo;
-                direction = "low";
-                redfishMessageID += ".SensorThresholdCriticalHighGoingLow";
+                assertedEvents.setDeasserted(path, descriptor.assertedEvent);
             }
-        }
-
-        std::string journalMsg(
-            std::string(sensorName) + " " + threshold + " threshold " +
-            (assert ? "assert" : "deassert") +
-            ". Reading=" + std::to_string(assertValue) +
-            " Threshold=" + std::to_string(thresholdVal) + ".");
 
-#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
-        std::string LogLevel = "";
-        switch (eventType)
-        {
-            case eventInfo:
-            {
-                LogLevel =
-                    "xyz.openbmc_project.Logging.Entry.Level.Informational";
-                break;
-            }
-            case eventWarn:
-            {
-                LogLevel = "xyz.openbmc_project.Logging.Entry.Level.Warning";
-                break;
-            }
-            case eventErr:
+            // Log the event even if the reading or threshold is missing,
+            // with the bytes that need it unspecified
+            std::optional<double> thresholdValue = getManagedDouble(
+                interfaces, descriptor.interface, descriptor.name);
+            if (!value)
             {
-                LogLevel = "xyz.openbmc_project.Logging.Entry.Level.Critical";
-                break;
+                std::cerr << "error getting sensor reading from " << path
+                          << "\n";
             }
-            default:
+            else if (!thresholdValue)
             {
-                LogLevel = "xyz.openbmc_project.Logging.Entry.Level.Debug";
-                break;
+                std::cerr << "error getting sensor threshold from " << path
+                          << "\n";
             }
+            SelEventData eventData;
+            eventData.fill(selEvtDataUnspecified);
+            eventData[0] = static_cast<uint8_t>(descriptor.offset) |
+                           thresholdEventDataTriggerReadingByte2 |
+                           thresholdEventDataTriggerReadingByte3;
+            std::string sensorName(path.substr(path.find_last_of('/') + 1));
+            logThresholdAssertEvent(conn, sensorName, path, descriptor,
+                                    *asserted, value, eventData, sensorValue,
+                                    thresholdValue);
         }
-        if (eventType != eventNone)
-        {
-            sdbusplus::message_t AddToLog = conn->new_method_call(
-                "xyz.openbmc_project.Logging", "/xyz/openbmc_project/logging",
-                "xyz.openbmc_project.Logging.Create", "Create");
-            AddToLog.append(journalMsg, LogLevel,
-                            std::map<std::string, std::string>(
-                                {{"SENSOR_PATH", std::string(msg.get_path())},
-                                 {"EVENT", threshold},
-                                 {"DIRECTION", direction},
-                                 {"THRESHOLD", std::to_string(thresholdVal)},
-                                 {"READING", std::to_string(assertValue)}}));
-            conn->call(AddToLog);
-        }
-#else
-        selAddSystemRecord(
-            conn, journalMsg, std::string(msg.get_path()), eventData, assert,
-            selBMCGenID, "REDFISH_MESSAGE_ID=%s", redfishMessageID.c_str(),
-            "REDFISH_MESSAGE_ARGS=%.*s,%f,%f", sensorName.length(),
-            sensorName.data(), assertValue, thresholdVal);
-#endif
-    };
-    sdbusplus::match thresholdAssertMatcher(
-        static_cast<sdbusplus::bus_t&>(*conn),
-        "type='signal', member='ThresholdAsserted'",
-        std::move(thresholdAssertMatcherCallback));
-    return thresholdAssertMatcher;
+    }
 }
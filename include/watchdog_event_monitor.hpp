@@ -17,12 +17,21 @@
 #pragma once
 #include <boost/container/flat_map.hpp>
 #include <sdbusplus/bus/match.hpp>
+#include <sel_deadline.hpp>
 #include <sel_logger.hpp>
+#include <sel_trace.hpp>
 #include <sensorutils.hpp>
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <utility>
 #include <variant>
+#include <vector>
 
 enum class watchdogEventOffsets : uint8_t
 {
@@ -55,74 +64,55 @@ enum class watchdogInterruptTypeOffsets : uint8_t
 static constexpr const uint8_t wdtNologBit = (1 << 7);
 static constexpr int interruptTypeBits = 4;
 
-inline static void sendWatchdogEventLog(
-    std::shared_ptr<sdbusplus::asio::connection> conn,
-    sdbusplus::message_t& msg, bool assert,
-    std::optional<std::string_view> expireAction = std::nullopt)
+static constexpr const char* watchdogInterface =
+    "xyz.openbmc_project.State.Watchdog";
+
+// Drop the enum namespace from a D-Bus enumeration value
+inline std::string_view watchdogEnumValue(std::string_view value)
 {
-    // SEL event data is three bytes where 0xFF means unspecified
-    std::vector<uint8_t> eventData(selEvtDataMaxSize, 0xFF);
+    value.remove_prefix(std::min(value.find_last_of(".") + 1, value.size()));
+    return value;
+}
 
-    sdbusplus::message_t getWatchdogStatus =
-        conn->new_method_call(msg.get_sender(), msg.get_path(),
-                              "org.freedesktop.DBus.Properties", "GetAll");
-    getWatchdogStatus.append("xyz.openbmc_project.State.Watchdog");
-    boost::container::flat_map<std::string,
-                               std::variant<std::string, uint64_t, bool>>
-        watchdogStatus;
+// The xyz.openbmc_project.State.Watchdog properties that go into a record
+struct WatchdogProperties
+{
+    std::string expireAction;
+    std::string preTimeoutInterrupt;
+    std::string currentTimerUse;
+    uint64_t interval = 0;
+};
 
-    try
-    {
-        sdbusplus::message_t getWatchdogStatusResp =
-            conn->call(getWatchdogStatus);
-        getWatchdogStatusResp.read(watchdogStatus);
-    }
-    catch (const sdbusplus::exception_t&)
-    {
-        std::cerr << "error getting watchdog status from " << msg.get_path()
-                  << "\n";
-        return;
-    }
+using WatchdogPropertyMap =
+    boost::container::flat_map<std::string,
+                               std::variant<std::string, uint64_t, bool>>;
 
-    if (!expireAction)
-    {
-        expireAction = "";
-        auto getExpireAction = watchdogStatus.find("ExpireAction");
-        if (getExpireAction != watchdogStatus.end())
-        {
-            expireAction = std::get<std::string>(getExpireAction->second);
-            expireAction->remove_prefix(std::min(
-                expireAction->find_last_of(".") + 1, expireAction->size()));
-        }
-    }
+// Build the SEL event data of a watchdog timeout
+inline SelEventData getWatchdogEventData(const WatchdogProperties& properties,
+                                         std::string_view expireAction)
+{
+    // SEL event data is three bytes where 0xFF means unspecified
+    SelEventData eventData;
+    eventData.fill(selEvtDataUnspecified);
 
-    if (*expireAction == "HardReset")
+    if (expireAction == "HardReset")
     {
         eventData[0] = static_cast<uint8_t>(watchdogEventOffsets::hardReset);
     }
-    else if (*expireAction == "PowerOff")
+    else if (expireAction == "PowerOff")
     {
         eventData[0] = static_cast<uint8_t>(watchdogEventOffsets::powerDown);
     }
-    else if (*expireAction == "PowerCycle")
+    else if (expireAction == "PowerCycle")
     {
         eventData[0] = static_cast<uint8_t>(watchdogEventOffsets::powerCycle);
     }
-    else if (*expireAction == "None")
+    else if (expireAction == "None")
     {
         eventData[0] = static_cast<uint8_t>(watchdogEventOffsets::noAction);
     }
 
-    auto getPreTimeoutInterrupt = watchdogStatus.find("PreTimeoutInterrupt");
-    std::string_view preTimeoutInterrupt;
-    if (getPreTimeoutInterrupt != watchdogStatus.end())
-    {
-        preTimeoutInterrupt =
-            std::get<std::string>(getPreTimeoutInterrupt->second);
-        preTimeoutInterrupt.remove_prefix(
-            std::min(preTimeoutInterrupt.find_last_of(".") + 1,
-                     preTimeoutInterrupt.size()));
-    }
+    std::string_view preTimeoutInterrupt = properties.preTimeoutInterrupt;
     if (preTimeoutInterrupt == "None")
     {
         eventData[1] &=
@@ -146,14 +136,7 @@ inline static void sendWatchdogEventLog(
                          << interruptTypeBits);
     }
 
-    auto getCurrentTimerUse = watchdogStatus.find("CurrentTimerUse");
-    std::string_view currentTimerUse;
-    if (getCurrentTimerUse != watchdogStatus.end())
-    {
-        currentTimerUse = std::get<std::string>(getCurrentTimerUse->second);
-        currentTimerUse.remove_prefix(std::min(
-            currentTimerUse.find_last_of(".") + 1, currentTimerUse.size()));
-    }
+    std::string_view currentTimerUse = properties.currentTimerUse;
     if (currentTimerUse == "BIOSFRB2")
     {
         eventData[1] |= static_cast<uint8_t>(watchdogTimerUseOffsets::BIOSFRB2);
@@ -179,82 +162,371 @@ inline static void sendWatchdogEventLog(
         eventData[1] |=
             static_cast<uint8_t>(watchdogTimerUseOffsets::unspecified);
     }
+    return eventData;
+}
+
+// A watchdog timeout together with the watchdog state it is logged with,
+// which is read over D-Bus, so it is traced once that state is known
+struct WatchdogTimeoutEvent
+{
+    static constexpr SelTraceKind traceKind = SelTraceKind::watchdogTimeout;
+
+    std::string path;
+    // The action from the Timeout signal, empty if it didn't say
+    std::string expireAction;
+    WatchdogProperties properties;
+    // The IPMI don't-log bit
+    bool nolog = false;
 
-    auto getWatchdogInterval = watchdogStatus.find("Interval");
-    uint64_t watchdogInterval = 0;
-    if (getWatchdogInterval != watchdogStatus.end())
+    template <typename Self>
+    static auto traceFields(Self& self)
     {
-        watchdogInterval = std::get<uint64_t>(getWatchdogInterval->second);
+        return std::tie(self.path, self.expireAction,
+                        self.properties.expireAction,
+                        self.properties.preTimeoutInterrupt,
+                        self.properties.currentTimerUse,
+                        self.properties.interval, self.nolog);
     }
+};
 
-    // get watchdog status properties
-    static bool wdt_nolog;
-    sdbusplus::bus_t bus = sdbusplus::bus::new_default();
-    uint8_t netFn = 0x06;
-    uint8_t lun = 0x00;
-    uint8_t cmd = 0x25;
-    std::vector<uint8_t> commandData;
-    std::map<std::string, std::variant<int>> options;
-
-    auto ipmiCall = bus.new_method_call(
-        "xyz.openbmc_project.Ipmi.Host", "/xyz/openbmc_project/Ipmi",
-        "xyz.openbmc_project.Ipmi.Server", "execute");
-    ipmiCall.append(netFn, lun, cmd, commandData, options);
-    std::tuple<uint8_t, uint8_t, uint8_t, uint8_t, std::vector<uint8_t>> rsp;
-    auto ipmiReply = bus.call(ipmiCall);
-    ipmiReply.read(rsp);
-    auto& [rnetFn, rlun, rcmd, cc, responseData] = rsp;
-
-    std::string direction;
-    std::string eventMessageArgs;
-    if (assert)
+inline static void logWatchdogTimeout(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    const WatchdogTimeoutEvent& timeout)
+{
+    if (timeout.nolog)
     {
-        direction = " enable ";
-        eventMessageArgs = "Enabled";
-        wdt_nolog = responseData[0] & wdtNologBit;
+        selMetricsSuppressed();
+        return;
     }
-    else
+    const WatchdogProperties& properties = timeout.properties;
+    // The action in the signal is the one that was taken
+    std::string_view expireAction = timeout.expireAction.empty()
+                                        ? properties.expireAction
+                                        : timeout.expireAction;
+    SelEventData eventData = getWatchdogEventData(properties, expireAction);
+
+    // Construct a human-readable message of this event for the log
+    SelMessageBuffer journalMsg;
+    journalMsg.append(properties.currentTimerUse)
+        .append(" enable watchdog countdown ")
+        .append(properties.interval / 1000)
+        .append(" seconds ")
+        .append(expireAction)
+        .append(" action");
+
+    SelJournalField<"REDFISH_MESSAGE_ARGS", 8> redfishMessageArgs;
+    redfishMessageArgs.append("Enabled");
+    selAddSystemRecord(conn, journalMsg.view(), timeout.path, eventData, true,
+                       selBMCGenID,
+                       SelSensorInfo{selSensorTypeWatchdog2,
+                                     selEventTypeSensorSpecific},
+                       "REDFISH_MESSAGE_ID=OpenBMC.0.1.IPMIWatchdog",
+                       redfishMessageArgs);
+}
+
+/** @class WatchdogEventMonitor
+ *  @brief Logs watchdog timeouts from cached watchdog state
+ *  @details The watchdog properties are read once per watchdog and then kept
+ *  up to date from PropertiesChanged signals.  The IPMI don't-log bit is read
+ *  again in the background whenever the host sets the watchdog's action,
+ *  interval or enabled state, which is when it can change, and is read with
+ *  the timeout if that read hasn't finished.  A timeout is then logged
+ *  without any D-Bus round trips.  Should those reads fail or run past the
+ *  event deadline, the timeout is logged with whatever they didn't get left
+ *  unspecified.
+ */
+class WatchdogEventMonitor
+{
+  public:
+    WatchdogEventMonitor(std::shared_ptr<sdbusplus::asio::connection> conn,
+                         const SelDeadlineConfig& deadlineConfig) :
+        conn(conn), deadlineConfig(deadlineConfig),
+        timeoutMatch(static_cast<sdbusplus::bus_t&>(*conn),
+                     "type='signal',interface='xyz.openbmc_project.Watchdog',"
+                     "member='Timeout'",
+                     [this](sdbusplus::message_t& msg) { timeout(msg); }),
+        propertiesMatch(
+            static_cast<sdbusplus::bus_t&>(*conn),
+            "type='signal',interface='org.freedesktop.DBus.Properties',"
+            "member='PropertiesChanged',arg0='" +
+                std::string(watchdogInterface) + "'",
+            [this](sdbusplus::message_t& msg) { propertiesChanged(msg); })
+    {}
+
+    WatchdogEventMonitor(const WatchdogEventMonitor&) = delete;
+    WatchdogEventMonitor& operator=(const WatchdogEventMonitor&) = delete;
+
+  private:
+    struct PendingTimeout
     {
-        direction = " disable ";
-        eventMessageArgs = "Disabled";
+        std::string expireAction;
+        std::optional<SelMetricsEvent> event;
+        SelDeadlineClock::time_point expiry;
+    };
+
+    struct Watchdog
+    {
+        std::optional<WatchdogProperties> properties;
+        // Timeouts waiting for the properties to be read
+        std::vector<PendingTimeout> pendingTimeouts;
+    };
+
+    void timeout(sdbusplus::message_t& msg)
+    {
+        std::string expireAction;
+        try
+        {
+            msg.read(expireAction);
+        }
+        catch (const sdbusplus::exception_t&)
+        {
+            std::cerr << "error getting watchdog timeout action from "
+                      << msg.get_path() << "\n";
+            return;
+        }
+        SelMetricsScope metricsScope(SelMetricSource::watchdog);
+        std::string path(msg.get_path());
+        SelDeadlineClock::time_point expiry = deadlineConfig.eventExpiry();
+        Watchdog& watchdog = watchdogs[path];
+        if (watchdog.properties)
+        {
+            logTimeout(path, *watchdog.properties,
+                       watchdogEnumValue(expireAction), expiry);
+            return;
+        }
+        watchdog.pendingTimeouts.emplace_back(
+            std::string(watchdogEnumValue(expireAction)), selMetricsEvent,
+            expiry);
+        // Only the first timeout reads the properties
+        if (watchdog.pendingTimeouts.size() > 1)
+        {
+            return;
+        }
+        std::shared_ptr<SelEventDeadline> deadline = SelEventDeadline::start(
+            conn->get_io_context(), expiry, [this, path]() {
+                std::cerr << "timed out getting watchdog status from " << path
+                          << "\n";
+                logPendingTimeouts(path, std::nullopt);
+            });
+        conn->async_method_call_timed(
+            [this, path, deadline](boost::system::error_code ec,
+                                   const WatchdogPropertyMap& values) {
+                // Anything the deadline already logged isn't pending anymore
+                deadline->claim();
+                if (ec)
+                {
+                    std::cerr << "error getting watchdog status from " << path
+                              << "\n";
+                    logPendingTimeouts(path, std::nullopt);
+                    return;
+                }
+                Watchdog& watchdog = watchdogs[path];
+                watchdog.properties.emplace();
+                updateProperties(*watchdog.properties, values);
+                logPendingTimeouts(path, watchdog.properties);
+            },
+            msg.get_sender(), path, "org.freedesktop.DBus.Properties",
+            "GetAll", deadlineConfig.callTimeoutUs(), watchdogInterface);
     }
 
-    // Set Watchdog Timer byte1[7]-1b=don't log
-    if (!wdt_nolog)
+    // Log the timeouts that were waiting for the watchdog properties, without
+    // them if they couldn't be read
+    void logPendingTimeouts(
+        const std::string& path,
+        const std::optional<WatchdogProperties>& properties)
     {
-        // Construct a human-readable message of this event for the log
-        std::string journalMsg(
-            std::string(currentTimerUse) + std::string(direction) +
-            "watchdog countdown " + std::to_string(watchdogInterval / 1000) +
-            " seconds " + std::string(*expireAction) + " action");
-
-        std::string redfishMessageID = "OpenBMC.0.1.IPMIWatchdog";
-
-        selAddSystemRecord(
-            conn, journalMsg, std::string(msg.get_path()), eventData, assert,
-            selBMCGenID, "REDFISH_MESSAGE_ID=%s", redfishMessageID.c_str(),
-            "REDFISH_MESSAGE_ARGS=%s", eventMessageArgs.c_str(), NULL);
+        std::vector<PendingTimeout> pending;
+        pending.swap(watchdogs[path].pendingTimeouts);
+        for (const PendingTimeout& timeout : pending)
+        {
+            SelMetricsScope metricsScope(timeout.event);
+            if (!properties)
+            {
+                selMetricsFailed();
+                selMetricsFallback();
+            }
+            logTimeout(path, properties.value_or(WatchdogProperties{}),
+                       timeout.expireAction, timeout.expiry);
+        }
     }
-}
 
-inline static sdbusplus::match startWatchdogEventMonitor(
-    std::shared_ptr<sdbusplus::asio::connection> conn)
-{
-    auto watchdogEventMatcherCallback = [conn](sdbusplus::message_t& msg) {
-        auto expiredAction = msg.unpack<std::string>();
+    void propertiesChanged(sdbusplus::message_t& msg)
+    {
+        std::string interface;
+        WatchdogPropertyMap values;
+        try
+        {
+            msg.read(interface, values);
+        }
+        catch (const sdbusplus::exception_t&)
+        {
+            return;
+        }
+        Watchdog& watchdog = watchdogs[msg.get_path()];
+        if (watchdog.properties)
+        {
+            updateProperties(*watchdog.properties, values);
+        }
+        // The don't-log bit is set by the same IPMI Set Watchdog Timer command
+        // as these, which may leave Enabled as it was.  Until it has been read
+        // again, a timeout reads it itself.
+        if (values.contains("Enabled") || values.contains("ExpireAction") ||
+            values.contains("Interval") || values.contains("CurrentTimerUse") ||
+            values.contains("PreTimeoutInterrupt"))
+        {
+            nolog.reset();
+            nologGeneration++;
+            refreshNolog(SelDeadlineClock::time_point::max(),
+                         [](std::optional<bool>) {});
+        }
+    }
+
+    static void updateProperties(WatchdogProperties& properties,
+                                 const WatchdogPropertyMap& values)
+    {
+        for (const auto& [name, value] : values)
+        {
+            if (name == "Interval")
+            {
+                if (const uint64_t* interval = std::get_if<uint64_t>(&value))
+                {
+                    properties.interval = *interval;
+                }
+                continue;
+            }
+            const std::string* text = std::get_if<std::string>(&value);
+            if (text == nullptr)
+            {
+                continue;
+            }
+            if (name == "ExpireAction")
+            {
+                properties.expireAction = watchdogEnumValue(*text);
+            }
+            else if (name == "PreTimeoutInterrupt")
+            {
+                properties.preTimeoutInterrupt = watchdogEnumValue(*text);
+            }
+            else if (name == "CurrentTimerUse")
+            {
+                properties.currentTimerUse = watchdogEnumValue(*text);
+            }
+        }
+    }
 
-        std::string_view action = expiredAction;
-        action.remove_prefix(
-            std::min(action.find_last_of(".") + 1, action.size()));
+    // Read the don't-log bit with an IPMI Get Watchdog Timer command.  If
+    // that fails or runs past expiry, handler gets nothing.
+    void refreshNolog(SelDeadlineClock::time_point expiry,
+                      std::function<void(std::optional<bool>)>&& handler)
+    {
+        // get watchdog status properties
+        uint8_t netFn = 0x06;
+        uint8_t lun = 0x00;
+        uint8_t cmd = 0x25;
+        std::vector<uint8_t> commandData;
+        std::map<std::string, std::variant<int>> options;
 
-        sendWatchdogEventLog(conn, msg, true, action);
-    };
+        auto sharedHandler =
+            std::make_shared<std::function<void(std::optional<bool>)>>(
+                std::move(handler));
+        std::shared_ptr<SelEventDeadline> deadline = SelEventDeadline::start(
+            conn->get_io_context(), expiry,
+            [sharedHandler, event = selMetricsEvent]() {
+                SelMetricsScope metricsScope(event);
+                std::cerr << "timed out getting watchdog timer from IPMI\n";
+                (*sharedHandler)(std::nullopt);
+            });
 
-    sdbusplus::match watchdogEventMatcher(
-        static_cast<sdbusplus::bus_t&>(*conn),
-        "type='signal',interface='xyz.openbmc_project.Watchdog',"
-        "member='Timeout'",
-        std::move(watchdogEventMatcherCallback));
+        auto ipmiCall = conn->new_method_call(
+            "xyz.openbmc_project.Ipmi.Host", "/xyz/openbmc_project/Ipmi",
+            "xyz.openbmc_project.Ipmi.Server", "execute");
+        ipmiCall.append(netFn, lun, cmd, commandData, options);
+        conn->async_send(
+            ipmiCall,
+            [this, sharedHandler, deadline, generation = nologGeneration,
+             event = selMetricsEvent](
+                boost::system::error_code ec, sdbusplus::message_t& ipmiReply) {
+                SelMetricsScope metricsScope(event);
+                std::tuple<uint8_t, uint8_t, uint8_t, uint8_t,
+                           std::vector<uint8_t>>
+                    rsp;
+                std::optional<bool> bit;
+                if (ec)
+                {
+                    std::cerr << "error getting watchdog timer from IPMI: "
+                              << ec.message() << "\n";
+                }
+                else
+                {
+                    try
+                    {
+                        ipmiReply.read(rsp);
+                        auto& [rnetFn, rlun, rcmd, cc, responseData] = rsp;
+                        // Set Watchdog Timer byte1[7]-1b=don't log
+                        bit = !responseData.empty() &&
+                              (responseData[0] & wdtNologBit);
+                        // A reply sent before the timer was re-armed may
+                        // hold the old bit
+                        if (generation == nologGeneration)
+                        {
+                            nolog = bit;
+                        }
+                    }
+                    catch (const sdbusplus::exception_t& e)
+                    {
+                        std::cerr << "error reading watchdog timer from IPMI: "
+                                  << e.what() << "\n";
+                    }
+                }
+                if (!deadline->claim())
+                {
+                    return;
+                }
+                (*sharedHandler)(bit);
+            },
+            deadlineConfig.callTimeoutUs());
+    }
+
+    void logTimeout(const std::string& path,
+                    const WatchdogProperties& properties,
+                    std::string_view signalExpireAction,
+                    SelDeadlineClock::time_point expiry)
+    {
+        auto log = [this, timeout = WatchdogTimeoutEvent{
+                              path, std::string(signalExpireAction),
+                              properties}](std::optional<bool> nolog) mutable {
+            if (!nolog)
+            {
+                // Log the timeout rather than lose it
+                selMetricsFailed();
+                selMetricsFallback();
+            }
+            timeout.nolog = nolog.value_or(false);
+            selTraceEvent(timeout);
+            logWatchdogTimeout(conn, timeout);
+        };
+        // Only read the don't-log bit if it isn't known yet
+        if (nolog)
+        {
+            log(nolog);
+            return;
+        }
+        refreshNolog(expiry, std::move(log));
+    }
+
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    SelDeadlineConfig deadlineConfig;
+    boost::container::flat_map<std::string, Watchdog> watchdogs;
+    std::optional<bool> nolog;
+    // Counts re-arms, so only a read started since the last one is cached
+    unsigned int nologGeneration = 0;
+    sdbusplus::match timeoutMatch;
+    sdbusplus::match propertiesMatch;
+};
 
-    return watchdogEventMatcher;
+inline static std::unique_ptr<WatchdogEventMonitor> startWatchdogEventMonitor(
+    std::shared_ptr<sdbusplus::asio::connection> conn,
+    const SelDeadlineConfig& deadlineConfig)
+{
+    return std::make_unique<WatchdogEventMonitor>(conn, deadlineConfig);
 }
@@ -15,17 +15,25 @@
 */
 #include <systemd/sd-journal.h>
 
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/split.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#ifdef SEL_LOGGER_WRITER_THREAD
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/steady_timer.hpp>
+#endif
 #include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
 #include <pulse_event_monitor.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <sel_log_index.hpp>
 #include <sel_logger.hpp>
 #include <threshold_event_monitor.hpp>
 #include <watchdog_event_monitor.hpp>
 #ifdef SEL_LOGGER_ENABLE_SEL_DELETE
+#include <record_id_bitmap.hpp>
+#ifdef SEL_LOGGER_SEL_DELETE_TOMBSTONES
+#include <sel_tombstones.hpp>
+#endif
 #include <xyz/openbmc_project/Common/error.hpp>
 #endif
 #ifdef SEL_LOGGER_MONITOR_THRESHOLD_ALARM_EVENTS
@@ -35,11 +43,17 @@
 #include <host_error_event_monitor.hpp>
 #endif
 
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <deque>
 #include <filesystem>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
-#include <sstream>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <variant>
 
 struct DBusInternalError final : public sdbusplus::exception_t
 {
@@ -103,207 +117,548 @@ static void saveClearSelTimestamp()
     close(fd);
 }
 
-#ifdef SEL_LOGGER_ENABLE_SEL_DELETE
-std::vector<uint16_t> nextRecordsCache;
+// Prefix of the directories cleared log files are moved to until they are
+// deleted.  They live in the log directory so moving the files there is only
+// a rename, and don't start with the log file name so they aren't taken for
+// log files.
+static const std::string selClearedDirPrefix = ".ipmi_sel-cleared-";
 
-static void backupCacheToFile()
+// Move the log files into a new directory of their own, so the SEL reads as
+// empty straight away without waiting for the files to be deleted
+static void stageSELLogFiles()
 {
-    std::ofstream nextRecordStream(selLogDir / nextRecordFilename);
-    for (const auto& recordIds : nextRecordsCache)
+    std::vector<std::filesystem::path> selLogFiles;
+    if (!getSELLogFiles(selLogFiles))
+    {
+        return;
+    }
+    std::string stagingDir =
+        (selLogDir / (selClearedDirPrefix + "XXXXXX")).string();
+    bool staged = mkdtemp(stagingDir.data()) != nullptr;
+    if (!staged)
     {
-        nextRecordStream << recordIds << '\n';
+        std::cerr << "Failed to create a directory for the cleared SEL: "
+                  << strerror(errno) << "\n";
+    }
+    for (const std::filesystem::path& file : selLogFiles)
+    {
+        std::error_code ec;
+        if (staged)
+        {
+            std::filesystem::rename(
+                file, std::filesystem::path(stagingDir) / file.filename(), ec);
+        }
+        if (!staged || ec)
+        {
+            // Delete it in place rather than leave it in the SEL
+            std::filesystem::remove(file, ec);
+        }
     }
 }
 
-uint16_t getNewRecordId()
+// Delete the log files of every clear so far, including any that were left
+// behind by a restart
+static void removeClearedSELLogFiles()
+{
+    std::error_code ec;
+    for (const std::filesystem::directory_entry& dirEnt :
+         std::filesystem::directory_iterator(selLogDir, ec))
+    {
+        if (dirEnt.path().filename().string().starts_with(selClearedDirPrefix))
+        {
+            std::error_code removeEc;
+            std::filesystem::remove_all(dirEnt.path(), removeEc);
+        }
+    }
+}
+
+// Reload rsyslog so it knows to start new log files, and delete the cleared
+// ones once it has let go of them.  The Clear reply doesn't wait for this.
+static void reloadRsyslog(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn)
+{
+    conn->async_method_call(
+        [event = selMetricsEvent](boost::system::error_code ec) {
+            if (ec)
+            {
+                std::cerr << "Failed to reload rsyslog: " << ec.message()
+                          << "\n";
+                selMetricsFailed(event);
+            }
+            removeClearedSELLogFiles();
+        },
+        "org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+        "org.freedesktop.systemd1.Manager", "ReloadUnit", "rsyslog.service",
+        "replace");
+}
+
+#ifdef SEL_LOGGER_WRITER_THREAD
+using SelMethodYield = boost::asio::yield_context;
+
+// Run change on the writer thread, after every record queued before it has
+// been written and before any record queued after it, then call then with its
+// result on the main loop.  The stores can't be changed anywhere else without
+// racing the writer.  change must not throw.
+template <typename Change, typename Then>
+static void selChangeStoresThen(boost::asio::io_context& io, Change&& change,
+                                Then&& then)
+{
+    getSelWriter().barrier([&io, change = std::forward<Change>(change),
+                            then = std::forward<Then>(then)]() mutable {
+        boost::asio::post(io, [then, result = change()]() mutable {
+            then(std::move(result));
+        });
+    });
+}
+
+// Run change like selChangeStoresThen() and wait for it without blocking the
+// main loop.  If change throws, the exception is rethrown here.
+template <typename Change>
+static auto selChangeStores(boost::asio::io_context& io, SelMethodYield yield,
+                            Change&& change)
 {
-    uint16_t nextRecordId = nextRecordsCache.back();
-    // Check if SEL is full
-    if (nextRecordId == selInvalidRecID)
+    using Result = decltype(change());
+    using Value =
+        std::conditional_t<std::is_void_v<Result>, std::monostate, Result>;
+    struct Outcome
     {
-        return nextRecordId;
+        std::optional<Value> value;
+        std::exception_ptr error;
+    };
+    boost::asio::steady_timer timer(
+        io, boost::asio::steady_timer::time_point::max());
+    Outcome outcome;
+    selChangeStoresThen(
+        io,
+        [&change]() {
+            Outcome changed;
+            try
+            {
+                if constexpr (std::is_void_v<Result>)
+                {
+                    change();
+                    changed.value.emplace();
+                }
+                else
+                {
+                    changed.value.emplace(change());
+                }
+            }
+            catch (...)
+            {
+                changed.error = std::current_exception();
+            }
+            return changed;
+        },
+        [&timer, &outcome](Outcome&& changed) {
+            outcome = std::move(changed);
+            timer.cancel();
+        });
+    boost::system::error_code ec;
+    timer.async_wait(yield[ec]);
+    if (outcome.error)
+    {
+        std::rethrow_exception(outcome.error);
     }
-    nextRecordsCache.pop_back();
-    if (nextRecordsCache.empty())
+    if constexpr (!std::is_void_v<Result>)
     {
-        nextRecordsCache.push_back(nextRecordId + 1);
+        return std::move(*outcome.value);
     }
-    backupCacheToFile();
-    return nextRecordId;
 }
+#else
+// Without a writer thread the stores are only used on the main loop, so they
+// are changed right away
+struct SelMethodYield
+{};
 
-static void initializeRecordId()
+template <typename Change>
+static auto selChangeStores(boost::asio::io_context&, SelMethodYield,
+                            Change&& change)
 {
-    std::ifstream nextRecordStream(selLogDir / nextRecordFilename);
-    if (!nextRecordStream.is_open())
+    return change();
+}
+#endif
+
+#ifdef SEL_LOGGER_ENABLE_SEL_DELETE
+static RecordIdBitmap recordIdBitmap(selLogDir / recordIdBitmapFilename);
+static SelLogIndex selLogIndex(selLogDir, selLogFilename);
+#ifdef SEL_LOGGER_SEL_DELETE_TOMBSTONES
+static SelTombstones selTombstones(selLogDir / selTombstoneFilename);
+// Only used on the main loop
+static bool selCompactionPending = false;
+// Compacts the tombstones left below the threshold once deletes go quiet
+static std::unique_ptr<boost::asio::steady_timer> selCompactionTimer;
+#endif
+// Counts clears, so a delete or compaction that finishes after a clear
+// doesn't free an ID the clear already gave out again
+static unsigned int selClearGeneration = 0;
+
+// Give back the IDs of the records the binary store has overwritten since
+// the last call
+static void freeOverwrittenRecordIds()
+{
+#ifdef SEL_LOGGER_BINARY_STORE
+    if constexpr (selReuseOverwrittenIds)
     {
-        std::ofstream newStream(selLogDir / nextRecordFilename);
-        newStream << '1' << '\n';
-        newStream.close();
-        nextRecordStream.open(selLogDir / nextRecordFilename);
+        for (uint16_t recordId : getSelBinaryStore().takeOverwrittenIds())
+        {
+            recordIdBitmap.free(recordId);
+        }
     }
-    std::string line;
-    while (std::getline(nextRecordStream, line))
+#endif
+}
+
+uint16_t getNewRecordId()
+{
+    freeOverwrittenRecordIds();
+    return recordIdBitmap.allocate();
+}
+
+std::vector<uint16_t> getNewRecordIds(size_t count)
+{
+    freeOverwrittenRecordIds();
+    std::vector<uint16_t> recordIds;
+    recordIds.reserve(count);
+    for (size_t i = 0; i < count; i++)
     {
-        nextRecordsCache.push_back(std::stoi(line));
+        recordIds.push_back(recordIdBitmap.allocate());
     }
+    return recordIds;
 }
 
-void clearSelLogFiles()
+#ifdef SEL_LOGGER_METRICS
+static uint32_t selFreeRecordIds()
 {
-    saveClearSelTimestamp();
+    return recordIdBitmap.freeCount();
+}
+#endif
 
-    // Clear the SEL by deleting the log files
-    std::vector<std::filesystem::path> selLogFiles;
-    if (getSELLogFiles(selLogFiles))
+// Fill in a new bitmap from the next_records file used by older versions.
+// The first line is the next unused record ID and the rest are deleted IDs.
+static void migrateNextRecords()
+{
+    std::ifstream nextRecordStream(selLogDir / nextRecordFilename);
+    if (!nextRecordStream.is_open())
     {
-        for (const std::filesystem::path& file : selLogFiles)
+        return;
+    }
+    std::string line;
+    bool first = true;
+    while (std::getline(nextRecordStream, line))
+    {
+        uint16_t recordId = 0;
+        auto [ptr, ec] = std::from_chars(
+            line.data(), line.data() + line.size(), recordId);
+        if (ec != std::errc())
         {
-            std::error_code ec;
-            std::filesystem::remove(file, ec);
+            continue;
+        }
+        if (first)
+        {
+            recordIdBitmap.reserveBelow(recordId);
+            first = false;
+        }
+        else
+        {
+            recordIdBitmap.free(recordId);
         }
     }
-    // Reload rsyslog so it knows to start new log files
-    boost::asio::io_context io;
-    auto dbus = std::make_shared<sdbusplus::asio::connection>(io);
-    sdbusplus::message_t rsyslogReload = dbus->new_method_call(
-        "org.freedesktop.systemd1", "/org/freedesktop/systemd1",
-        "org.freedesktop.systemd1.Manager", "ReloadUnit");
-    rsyslogReload.append("rsyslog.service", "replace");
-    try
+    nextRecordStream.close();
+    std::error_code ec;
+    std::filesystem::remove(selLogDir / nextRecordFilename, ec);
+}
+
+static void initializeRecordId()
+{
+    if (recordIdBitmap.open())
     {
-        sdbusplus::message_t reloadResponse = dbus->call(rsyslogReload);
+        migrateNextRecords();
     }
-    catch (const sdbusplus::exception_t& e)
+}
+
+// Records added from now on get IDs from 1 again and go in the new log, the
+// ones still queued are written to the old one before it is cleared
+void clearSelLogFiles(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    SelMethodYield yield)
+{
+    // Not kept open while waiting, other handlers run meanwhile
+    std::optional<SelMetricsEvent> event;
     {
-        std::cerr << e.what() << "\n";
+        SelMetricsScope metricsScope(SelMetricSource::clear);
+        event = selMetricsEvent;
     }
-    // Set next record to 1
-    nextRecordsCache.clear();
-    nextRecordsCache.push_back(1);
-    // Update backup file as well
-    std::ofstream nextRecordStream(selLogDir / nextRecordFilename);
-    nextRecordStream << '1' << '\n';
+
+    // Start again from record 1
+    recordIdBitmap.clear();
+    selClearGeneration++;
+
+    selChangeStores(conn->get_io_context(), yield, []() {
+        saveClearSelTimestamp();
+
+        // Clear the SEL by moving the log files away, they are deleted once
+        // rsyslog has started new ones
+        stageSELLogFiles();
+
+#ifdef SEL_LOGGER_BINARY_STORE
+        getSelBinaryStore().clear();
+#endif
+        selLogIndex.clear();
+#ifdef SEL_LOGGER_SEL_DELETE_TOMBSTONES
+        selTombstones.clear();
+#endif
+    });
+    SelMetricsScope metricsScope(event);
+    selMetricsCommitted();
+
+    reloadRsyslog(conn);
 }
 
 static bool selDeleteTargetRecord(const uint16_t& targetId)
 {
-    bool targetEntryFound = false;
-    // Check if the ipmi_sel exist and save the path
-    std::vector<std::filesystem::path> selLogFiles;
-    if (!getSELLogFiles(selLogFiles))
+    // The index knows which file and offset hold the entry, so only the file
+    // holding it is touched
+    return selLogIndex.remove(targetId);
+}
+
+#ifdef SEL_LOGGER_SEL_DELETE_TOMBSTONES
+// What a compaction run did
+struct SelCompaction
+{
+    // Record IDs whose lines are gone
+    std::vector<uint16_t> done;
+    // Tombstones left
+    size_t tombstones = 0;
+    // Whether the whole batch was done, so another run can follow
+    bool complete = true;
+};
+
+// Physically remove a batch of tombstoned lines from the log files
+static SelCompaction selCompactTombstoneBatch()
+{
+    SelCompaction compaction;
+    std::vector<uint16_t> batch = selTombstones.first(selCompactionBatchSize);
+    if (batch.empty())
     {
-        return targetEntryFound;
+        return compaction;
     }
 
-    // Go over all the ipmi_sel files to remove the entry with the target ID
-    for (const std::filesystem::path& file : selLogFiles)
+    std::error_code ec;
+    std::filesystem::file_time_type prevAddTime =
+        std::filesystem::last_write_time(selLogDir / selLogFilename, ec);
+    std::vector<uint16_t> removed = selLogIndex.remove(batch);
+    if (!ec)
+    {
+        // Keep Last Add Time the same
+        std::filesystem::last_write_time(selLogDir / selLogFilename,
+                                         prevAddTime, ec);
+    }
+
+    // A record that is no longer in any log file (e.g. it was rotated out)
+    // is done as well; anything still there failed and is retried later
+    for (uint16_t recordId : batch)
     {
-        std::fstream logStream(file, std::ios::in);
-        std::fstream tempFile(selLogDir / "temp", std::ios::out);
-        if (!logStream.is_open())
+        if (std::find(removed.begin(), removed.end(), recordId) !=
+                removed.end() ||
+            !selLogIndex.find(recordId))
         {
-            return targetEntryFound;
+            compaction.done.push_back(recordId);
         }
-        std::string line;
-        while (std::getline(logStream, line))
-        {
-            // Get the recordId of the current entry
-            int left = line.find(" ");
-            int right = line.find(",");
-            int recordLen = right - left;
-            std::string recordId = line.substr(left, recordLen);
-            int newRecordId = std::stoi(recordId);
-
-            if (newRecordId != targetId)
-            {
-                // Copy the entry from the original ipmi_sel to the temp file
-                tempFile << line << '\n';
-            }
-            else
+    }
+    selTombstones.remove(compaction.done);
+    compaction.tombstones = selTombstones.size();
+    compaction.complete = compaction.done.size() == batch.size();
+    return compaction;
+}
+
+static void selScheduleCompaction(boost::asio::io_context& io,
+                                  size_t tombstones);
+
+// Compact a batch of tombstones on the writer thread, then give their record
+// IDs back for reuse on the main loop
+static void selCompactTombstones(boost::asio::io_context& io)
+{
+    unsigned int generation = selClearGeneration;
+    selChangeStoresThen(
+        io, selCompactTombstoneBatch,
+        [&io, generation](SelCompaction&& compaction) {
+            selCompactionPending = false;
+            // A clear since has already freed every ID
+            if (generation != selClearGeneration)
             {
-                // Skip copying the target entry
-                targetEntryFound = true;
+                return;
             }
-        }
-        logStream.close();
-        tempFile.close();
-        if (targetEntryFound)
-        {
-            std::fstream logStream(file, std::ios::out);
-            std::fstream tempFile(selLogDir / "temp", std::ios::in);
-            while (std::getline(tempFile, line))
+            for (uint16_t recordId : compaction.done)
             {
-                logStream << line << '\n';
+                recordIdBitmap.free(recordId);
             }
-            logStream.close();
-            tempFile.close();
-            std::error_code ec;
-            if (!std::filesystem::remove(selLogDir / "temp", ec))
+            if (compaction.complete)
             {
-                std::cerr << ec.message() << std::endl;
+                selScheduleCompaction(io, compaction.tombstones);
             }
-            break;
-        }
+        });
+}
+
+static void selStartCompaction(boost::asio::io_context& io)
+{
+    if (selCompactionPending)
+    {
+        return;
     }
-    return targetEntryFound;
+    // Posted so the SELDelete reply goes out before the batch is queued
+    selCompactionPending = true;
+    boost::asio::post(io, [&io]() { selCompactTombstones(io); });
+}
+
+static void selScheduleCompaction(boost::asio::io_context& io,
+                                  size_t tombstones)
+{
+    if (tombstones == 0)
+    {
+        return;
+    }
+    if (tombstones >= selCompactionThreshold)
+    {
+        selStartCompaction(io);
+        return;
+    }
+    // Fewer tombstones would stay in the log files for IPMI readers to see
+    // until more records are deleted, so they are removed once no record has
+    // been deleted for a while.  Each delete restarts the wait.
+    if (!selCompactionTimer)
+    {
+        selCompactionTimer = std::make_unique<boost::asio::steady_timer>(io);
+    }
+    selCompactionTimer->expires_after(selCompactionDelay);
+    selCompactionTimer->async_wait([&io](const boost::system::error_code& ec) {
+        if (!ec)
+        {
+            selStartCompaction(io);
+        }
+    });
 }
+#endif
+
+// What deleting a record from the stores found
+struct SelDeleteResult
+{
+    bool found = false;
+    // Whether the record ID can be given out again right away
+    bool reuseNow = true;
+    // Tombstones waiting for compaction
+    size_t tombstones = 0;
+};
 
-static void selDeleteRecord(const uint16_t& recordId)
+static SelDeleteResult selDeleteFromStores(uint16_t recordId)
 {
+    SelDeleteResult result;
+#ifdef SEL_LOGGER_BINARY_STORE
+    result.found = getSelBinaryStore().deleteRecord(recordId);
+#endif
+#ifndef SEL_LOGGER_BINARY_STORE_NO_JOURNAL
+#ifdef SEL_LOGGER_SEL_DELETE_TOMBSTONES
+    // Only mark the record as deleted, the line is removed later by compaction
+    if (!selTombstones.contains(recordId) && selLogIndex.find(recordId))
+    {
+        selTombstones.add(recordId);
+        result.found = true;
+        // The ID stays reserved until compaction removes the line, otherwise
+        // a new record would be hidden by the tombstone
+        result.reuseNow = false;
+    }
+    result.tombstones = selTombstones.size();
+#else
     std::filesystem::file_time_type prevAddTime =
         std::filesystem::last_write_time(selLogDir / selLogFilename);
-    bool targetEntryFound = selDeleteTargetRecord(recordId);
+    result.found = selDeleteTargetRecord(recordId) || result.found;
+#endif
+#endif
 
-    // Check if the Record Id was found
-    if (!targetEntryFound)
+    if (!result.found)
     {
-        throw sdbusplus::xyz::openbmc_project::Common::Error::
-            ResourceNotFound();
+        return result;
     }
-    // Add to next record cache for reuse
-    nextRecordsCache.push_back(recordId);
-    // Add to backup file
-    std::ofstream nextRecordStream(selLogDir / nextRecordFilename,
-                                   std::ios::app);
-    nextRecordStream << recordId << '\n';
+#if !defined(SEL_LOGGER_BINARY_STORE_NO_JOURNAL) &&                            \
+    !defined(SEL_LOGGER_SEL_DELETE_TOMBSTONES)
     // Keep Last Add Time the same
     std::filesystem::last_write_time(selLogDir / selLogFilename, prevAddTime);
+#endif
     // Update Last Del Time
     saveClearSelTimestamp();
+    return result;
 }
-#else
-static unsigned int initializeRecordId()
+
+static void selDeleteRecord(boost::asio::io_context& io, SelMethodYield yield,
+                            const uint16_t& recordId)
 {
-    std::vector<std::filesystem::path> selLogFiles;
-    if (!getSELLogFiles(selLogFiles))
+    // Not kept open while waiting, other handlers run meanwhile
+    std::optional<SelMetricsEvent> event;
     {
-        return 0;
+        SelMetricsScope metricsScope(SelMetricSource::selDelete);
+        event = selMetricsEvent;
     }
-    std::ifstream logStream(selLogFiles.front());
-    if (!logStream.is_open())
+
+    unsigned int generation = selClearGeneration;
+    // The record may still be queued, so it is deleted in order with the
+    // records being written
+    SelDeleteResult result = selChangeStores(
+        io, yield, [recordId]() { return selDeleteFromStores(recordId); });
+    SelMetricsScope metricsScope(event);
+
+    // Check if the Record Id was found
+    if (!result.found)
     {
-        return 0;
+        throw sdbusplus::xyz::openbmc_project::Common::Error::
+            ResourceNotFound();
     }
-    std::string line;
-    std::string newestEntry;
-    while (std::getline(logStream, line))
+    // A clear since has already freed every ID
+    if (generation == selClearGeneration)
     {
-        newestEntry = line;
+#ifdef SEL_LOGGER_SEL_DELETE_TOMBSTONES
+        if (!result.reuseNow)
+        {
+            selScheduleCompaction(io, result.tombstones);
+        }
+        else
+#endif
+        {
+            // Free the record ID for reuse
+            recordIdBitmap.free(recordId);
+        }
     }
-
-    std::vector<std::string> newestEntryFields;
-    boost::split(newestEntryFields, newestEntry, boost::is_any_of(" ,"),
-                 boost::token_compress_on);
-    if (newestEntryFields.size() < 4)
+    selMetricsCommitted();
+}
+#else
+static unsigned int initializeRecordId()
+{
+    uint16_t highest = 0;
+#ifdef SEL_LOGGER_BINARY_STORE
+    // The binary store keeps the highest record ID.  It may have been created
+    // after ipmi_sel, which then holds higher IDs, so that is read as well.
+    highest = getSelBinaryStore().highestRecordId();
+#endif
+    std::vector<std::filesystem::path> selLogFiles;
+    if (!getSELLogFiles(selLogFiles))
     {
-        return 0;
+        return highest;
     }
-
-    return std::stoul(newestEntryFields[1]);
+    // Only the records that may have been written out of order need to be
+    // read, from the end of the newest files
+    size_t count = selWriteReorderWindow;
+    for (const std::filesystem::path& file : selLogFiles)
+    {
+        highest = std::max(highest,
+                           readHighestSelRecordId(file, count).value_or(0));
+        if (count == 0)
+        {
+            break;
+        }
+    }
+    return highest;
 }
 
-static unsigned int recordId = initializeRecordId();
+// Set up by initializeRecordId() from main(), after the D-Bus name is taken
+static unsigned int recordId = 0;
 
 unsigned int getNewRecordId()
 {
@@ -314,157 +669,848 @@ unsigned int getNewRecordId()
     return recordId;
 }
 
-void clearSelLogFiles()
+std::vector<uint16_t> getNewRecordIds(size_t count)
 {
-    saveClearSelTimestamp();
-
-    // Clear the SEL by deleting the log files
-    std::vector<std::filesystem::path> selLogFiles;
-    if (getSELLogFiles(selLogFiles))
+    std::vector<uint16_t> recordIds;
+    recordIds.reserve(count);
+    for (size_t i = 0; i < count; i++)
     {
-        for (const std::filesystem::path& file : selLogFiles)
-        {
-            std::error_code ec;
-            std::filesystem::remove(file, ec);
-        }
+        recordIds.push_back(getNewRecordId());
     }
+    return recordIds;
+}
 
-    recordId = 0;
+#ifdef SEL_LOGGER_METRICS
+static uint32_t selFreeRecordIds()
+{
+    // IDs are handed out in order and only given back by a clear
+    return recordId < selInvalidRecID ? selInvalidRecID - 1 - recordId : 0;
+}
+#endif
 
-    // Reload rsyslog so it knows to start new log files
-    boost::asio::io_context io;
-    auto dbus = std::make_shared<sdbusplus::asio::connection>(io);
-    sdbusplus::message_t rsyslogReload = dbus->new_method_call(
-        "org.freedesktop.systemd1", "/org/freedesktop/systemd1",
-        "org.freedesktop.systemd1.Manager", "ReloadUnit");
-    rsyslogReload.append("rsyslog.service", "replace");
-    try
-    {
-        sdbusplus::message_t reloadResponse = dbus->call(rsyslogReload);
-    }
-    catch (const sdbusplus::exception_t& e)
+// Records added from now on get IDs from 1 again and go in the new log, the
+// ones still queued are written to the old one before it is cleared
+void clearSelLogFiles(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    SelMethodYield yield)
+{
+    // Not kept open while waiting, other handlers run meanwhile
+    std::optional<SelMetricsEvent> event;
     {
-        std::cerr << e.what() << "\n";
+        SelMetricsScope metricsScope(SelMetricSource::clear);
+        event = selMetricsEvent;
     }
+
+    // Start again from record 1
+    recordId = 0;
+
+    selChangeStores(conn->get_io_context(), yield, []() {
+        saveClearSelTimestamp();
+
+        // Clear the SEL by moving the log files away, they are deleted once
+        // rsyslog has started new ones
+        stageSELLogFiles();
+
+#ifdef SEL_LOGGER_BINARY_STORE
+        getSelBinaryStore().clear();
+#endif
+    });
+    SelMetricsScope metricsScope(event);
+    selMetricsCommitted();
+
+    reloadRsyslog(conn);
 }
 #endif
 #endif
 
-void toHexStr(const std::vector<uint8_t>& data, std::string& hexStr)
+#ifndef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+#ifndef SEL_LOGGER_BINARY_STORE_NO_JOURNAL
+static void selJournalOemRecord(unsigned int recordId,
+                                std::string_view message,
+                                std::span<const uint8_t> selData,
+                                const uint8_t& recordType)
 {
-    std::stringstream stream;
-    stream << std::hex << std::uppercase << std::setfill('0');
-    for (int v : data)
-    {
-        stream << std::setw(2) << v;
-    }
-    hexStr = stream.str();
+    SelJournalField<"IPMI_SEL_RECORD_ID", 5> recordIdField;
+    recordIdField.append(recordId);
+    SelJournalField<"IPMI_SEL_RECORD_TYPE", 2> recordTypeField;
+    recordTypeField.append(recordType, 16);
+    SelJournalField<"IPMI_SEL_DATA", selOemDataMaxSize * 2> selDataField;
+    selDataField.appendHex(selData);
+
+    selJournalSend(selJournalTextField<"MESSAGE">(message), selPriorityField,
+                   selMessageIdField, recordIdField, recordTypeField,
+                   selDataField);
+}
+#endif
+
+// Store an OEM record that has been given a record ID in the binary store
+// and/or the journal, depending on how the daemon was built
+static void selStoreOemRecord(unsigned int recordId,
+                              [[maybe_unused]] std::string_view message,
+                              std::span<const uint8_t> selData,
+                              const uint8_t& recordType)
+{
+#ifdef SEL_LOGGER_BINARY_STORE
+    getSelBinaryStore().addOemRecord(recordId, recordType, selData);
+#endif
+#ifndef SEL_LOGGER_BINARY_STORE_NO_JOURNAL
+    selJournalOemRecord(recordId, message, selData, recordType);
+#endif
+}
+
+// Write an OEM record that has been given a record ID, either now or on the
+// writer thread
+static void selWriteOemRecord(unsigned int recordId, std::string_view message,
+                              std::span<const uint8_t> selData,
+                              const uint8_t& recordType)
+{
+#ifdef SEL_LOGGER_WRITER_THREAD
+    getSelWriter().push(
+        SelWritePriority::normal, recordId,
+        [recordId, message = std::string(message),
+         data = std::vector<uint8_t>(selData.begin(), selData.end()),
+         recordType, event = selMetricsEvent](bool write) {
+            if (!write)
+            {
+                selMetricsSuppressed(event);
+                return;
+            }
+            selStoreOemRecord(recordId, message, data, recordType);
+            selMetricsWritten(event);
+        },
+        selCommitDone());
+#else
+    selStoreOemRecord(recordId, message, selData, recordType);
+    selMetricsWritten();
+#endif
 }
+#endif
 
 static uint16_t selAddOemRecord(
     [[maybe_unused]] std::shared_ptr<sdbusplus::asio::connection> conn,
-    [[maybe_unused]] const std::string& message,
-    const std::vector<uint8_t>& selData, const uint8_t& recordType)
+    [[maybe_unused]] std::string_view message,
+    std::span<const uint8_t> selData, const uint8_t& recordType)
 {
     // A maximum of 13 bytes of SEL event data are allowed in an OEM record
     if (selData.size() > selOemDataMaxSize)
     {
         throw std::invalid_argument("Event data too large");
     }
+
+#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
     std::string selDataStr;
     toHexStr(selData, selDataStr);
 
-#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
-    sdbusplus::message_t AddToLog = conn->new_method_call(
-        "xyz.openbmc_project.Logging", "/xyz/openbmc_project/logging",
-        "xyz.openbmc_project.Logging.Create", "Create");
+    // Not a SelMessageBuffer, the caller's message can be any length
+    std::string journalMsg(message);
+    journalMsg += ":  RecordType=" + std::to_string(recordType) +
+                  ", GeneratorID=0, EventDir=0, EventData=" + selDataStr;
 
-    std::string journalMsg(
-        message + ": " + " RecordType=" + std::to_string(recordType) +
-        ", GeneratorID=" + std::to_string(0) +
-        ", EventDir=" + std::to_string(0) + ", EventData=" + selDataStr);
+    createLogEntry(conn, journalMsg,
+                   "xyz.openbmc_project.Logging.Entry.Level.Informational",
+                   {{"SENSOR_PATH", ""},
+                    {"GENERATOR_ID", std::to_string(0)},
+                    {"RECORD_TYPE", std::to_string(recordType)},
+                    {"EVENT_DIR", std::to_string(0)},
+                    {"SENSOR_DATA", selDataStr}});
+    return 0;
+#else
+    unsigned int recordId = getNewRecordId();
+    if (recordId < selInvalidRecID)
+    {
+        selWriteOemRecord(recordId, message, selData, recordType);
+    }
+    return recordId;
+#endif
+}
 
-    try
+static std::vector<uint16_t> selAddSystemRecords(
+    [[maybe_unused]] std::shared_ptr<sdbusplus::asio::connection> conn,
+    const std::vector<SelSystemEntry>& entries)
+{
+#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+    std::vector<uint16_t> recordIds;
+    recordIds.reserve(entries.size());
+    for (const auto& [message, path, selData, assert, genId] : entries)
     {
-        AddToLog.append(
-            journalMsg, "xyz.openbmc_project.Logging.Entry.Level.Informational",
-            std::map<std::string, std::string>(
-                {{"SENSOR_PATH", ""},
-                 {"GENERATOR_ID", std::to_string(0)},
-                 {"RECORD_TYPE", std::to_string(recordType)},
-                 {"EVENT_DIR", std::to_string(0)},
-                 {"SENSOR_DATA", selDataStr}}));
-        conn->call(AddToLog);
+        recordIds.push_back(
+            selAddSystemRecord(conn, message, path, selData, assert, genId,
+                               selDBusSensorInfo(path)));
     }
-    catch (const std::exception& e)
+    return recordIds;
+#else
+    // Reject the whole batch before any record IDs are allocated
+    for (const auto& entry : entries)
     {
-        std::cerr << "Failed adding this event: " << e.what() << "\n";
+        if (std::get<std::vector<uint8_t>>(entry).size() > selEvtDataMaxSize)
+        {
+            throw std::invalid_argument("Event data too large");
+        }
     }
-    return 0;
+    std::vector<uint16_t> recordIds = getNewRecordIds(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (recordIds[i] >= selInvalidRecID)
+        {
+            continue;
+        }
+        const auto& [message, path, selData, assert, genId] = entries[i];
+        selWriteSystemRecord(recordIds[i], message, path, selData, assert,
+                             genId, selDBusSensorInfo(path));
+    }
+    return recordIds;
+#endif
+}
+
+static std::vector<uint16_t> selAddOemRecords(
+    [[maybe_unused]] std::shared_ptr<sdbusplus::asio::connection> conn,
+    const std::vector<SelOemEntry>& entries)
+{
+#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+    std::vector<uint16_t> recordIds;
+    recordIds.reserve(entries.size());
+    for (const auto& [message, selData, recordType] : entries)
+    {
+        recordIds.push_back(
+            selAddOemRecord(conn, message, selData, recordType));
+    }
+    return recordIds;
 #else
-    unsigned int recordId = getNewRecordId();
-    if (recordId < selInvalidRecID)
+    // Reject the whole batch before any record IDs are allocated
+    for (const auto& entry : entries)
     {
-        sd_journal_send("MESSAGE=%s", message.c_str(), "PRIORITY=%i",
-                        selPriority, "MESSAGE_ID=%s", selMessageId,
-                        "IPMI_SEL_RECORD_ID=%d", recordId,
-                        "IPMI_SEL_RECORD_TYPE=%x", recordType,
-                        "IPMI_SEL_DATA=%s", selDataStr.c_str(), NULL);
+        if (std::get<std::vector<uint8_t>>(entry).size() > selOemDataMaxSize)
+        {
+            throw std::invalid_argument("Event data too large");
+        }
     }
-    return recordId;
+    std::vector<uint16_t> recordIds = getNewRecordIds(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (recordIds[i] >= selInvalidRecID)
+        {
+            continue;
+        }
+        const auto& [message, selData, recordType] = entries[i];
+        selWriteOemRecord(recordIds[i], message, selData, recordType);
+    }
+    return recordIds;
+#endif
+}
+
+// Capture the arguments of add calls, only copying them while capturing
+static void selTraceAdd([[maybe_unused]] const std::string& message,
+                        [[maybe_unused]] const std::string& path,
+                        [[maybe_unused]] const std::vector<uint8_t>& selData,
+                        [[maybe_unused]] bool assert,
+                        [[maybe_unused]] uint16_t genId)
+{
+#ifdef SEL_LOGGER_TRACE
+    if (getSelTraceCapture().active())
+    {
+        selTraceEvent(IpmiSelAddCall{message, path, selData, assert, genId});
+    }
+#endif
+}
+
+static void selTraceAddOem([[maybe_unused]] const std::string& message,
+                           [[maybe_unused]] const std::vector<uint8_t>& selData,
+                           [[maybe_unused]] uint8_t recordType)
+{
+#ifdef SEL_LOGGER_TRACE
+    if (getSelTraceCapture().active())
+    {
+        selTraceEvent(IpmiSelAddOemCall{message, selData, recordType});
+    }
+#endif
+}
+
+// Batches are traced one entry at a time, as if each were a single call
+static void selTraceAddBatch(const std::vector<SelSystemEntry>& entries)
+{
+    for (const auto& [message, path, selData, assert, genId] : entries)
+    {
+        selTraceAdd(message, path, selData, assert, genId);
+    }
+}
+
+static void selTraceAddOemBatch(const std::vector<SelOemEntry>& entries)
+{
+    for (const auto& [message, selData, recordType] : entries)
+    {
+        selTraceAddOem(message, selData, recordType);
+    }
+}
+
+#ifdef SEL_LOGGER_WRITER_THREAD
+struct SelRecordDroppedError final : public sdbusplus::exception_t
+{
+    const char* name() const noexcept override
+    {
+        return "org.freedesktop.DBus.Error.LimitsExceeded";
+    }
+    const char* description() const noexcept override
+    {
+        return "SEL write queue full, record dropped";
+    }
+    const char* what() const noexcept override
+    {
+        return "org.freedesktop.DBus.Error.LimitsExceeded: "
+               "SEL write queue full, record dropped";
+    }
+
+    int get_errno() const noexcept override
+    {
+        return ENOSPC;
+    }
+};
+
+// Normal records of a batch, the ones that need room in the normal lane
+static size_t selNormalRecordCount(const std::vector<SelSystemEntry>& entries)
+{
+    return std::count_if(
+        entries.begin(), entries.end(), [](const SelSystemEntry& entry) {
+            return selSystemRecordPriority(std::get<std::vector<uint8_t>>(entry),
+                                           std::get<bool>(entry)) ==
+                   SelWritePriority::normal;
+        });
+}
+
+// Wait without blocking the main loop until the writer queue has room for the
+// count normal records of a call, then run add, then wait until every record
+// it queued has been committed, so a reply means the records are stored.  The
+// call fails instead if any of them was dropped.  Record IDs are only given
+// out once there is room, so a critical record added meanwhile can't get
+// ahead of more normal records than the queue holds.
+template <typename Add>
+static auto selAddAndWait(
+    const std::shared_ptr<sdbusplus::asio::connection>& conn,
+    boost::asio::yield_context yield, size_t count, Add&& add)
+{
+    if (count > SEL_LOGGER_WRITER_QUEUE_DEPTH)
+    {
+        throw std::invalid_argument("Batch larger than the SEL write queue");
+    }
+    boost::asio::io_context& io = conn->get_io_context();
+    boost::asio::steady_timer roomTimer(
+        io, boost::asio::steady_timer::time_point::max());
+    while (true)
+    {
+        bool room = getSelWriter().room(count, [&io, &roomTimer]() {
+            boost::asio::post(io, [&roomTimer]() { roomTimer.cancel(); });
+        });
+        if (room)
+        {
+            break;
+        }
+        boost::system::error_code ec;
+        roomTimer.async_wait(yield[ec]);
+        roomTimer.expires_at(boost::asio::steady_timer::time_point::max());
+    }
+
+    auto group = std::make_shared<SelCommitGroup>();
+    selCommitGroup = group;
+    auto result = [&]() {
+        try
+        {
+            return add();
+        }
+        catch (...)
+        {
+            selCommitGroup.reset();
+            throw;
+        }
+    }();
+    selCommitGroup.reset();
+    if (group->pending != 0)
+    {
+        boost::asio::steady_timer timer(
+            conn->get_io_context(),
+            boost::asio::steady_timer::time_point::max());
+        group->committed = [&timer]() { timer.cancel(); };
+        boost::system::error_code ec;
+        timer.async_wait(yield[ec]);
+    }
+    if (group->dropped != 0)
+    {
+        throw SelRecordDroppedError();
+    }
+    return result;
+}
+
+// Write what a batch changed in the memory-mapped stores out once, on the
+// writer thread, so that by the time a caller is told its record is stored
+// the record and the record ID allocation survive a power loss
+static void selSyncStores()
+{
+#ifdef SEL_LOGGER_BINARY_STORE
+    getSelBinaryStore().sync();
+#endif
+#ifdef SEL_LOGGER_ENABLE_SEL_DELETE
+    recordIdBitmap.sync();
 #endif
 }
+#endif
 
-int main(int, char*[])
+// Recover the record ID state and start the writer
+static void initializeSelState([[maybe_unused]] boost::asio::io_context& io)
 {
 #ifndef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
 #ifdef SEL_LOGGER_ENABLE_SEL_DELETE
     initializeRecordId();
+#ifndef SEL_LOGGER_BINARY_STORE_NO_JOURNAL
+    selLogIndex.refresh();
 #endif
+#ifdef SEL_LOGGER_SEL_DELETE_TOMBSTONES
+    // Finish compacting anything left over from before a restart
+    selTombstones.load();
+    selScheduleCompaction(io, selTombstones.size());
 #endif
-    // setup connection to dbus
+#else
+    recordId = initializeRecordId();
+#endif
+    // Finish deleting the files of a clear that was cut short by a restart
+    boost::asio::post(io, removeClearedSELLogFiles);
+#ifdef SEL_LOGGER_WRITER_THREAD
+#ifdef SEL_LOGGER_BINARY_STORE
+    // Open the store before the writer starts, so it outlives the writer
+    getSelBinaryStore();
+#endif
+    SelWriter& selWriter = getSelWriter();
+    // Persist each batch once, then answer the callers waiting on it back on
+    // this thread, with one post per batch
+    selWriter.setCommitHandler(
+        [&io](std::vector<SelWriter::Done>&& dones, bool written) {
+            if (written)
+            {
+                selSyncStores();
+            }
+            if (dones.empty())
+            {
+                return;
+            }
+            boost::asio::post(io, [dones = std::move(dones), written]() {
+                for (const SelWriter::Done& done : dones)
+                {
+                    done(written);
+                }
+            });
+        });
+#ifdef SEL_LOGGER_ENABLE_SEL_DELETE
+    // A dropped record never reaches the log, so its ID can be used again
+    selWriter.setDropHandler(
+        [](uint16_t droppedId) { recordIdBitmap.free(droppedId); });
+#endif
+#endif
+#endif
+}
+
+#if defined(SEL_LOGGER_TRACE) && !defined(SEL_LOGGER_SEND_TO_LOGGING_SERVICE)
+// Feed a trace to this build's handlers, with no bus.  Records of monitors
+// that aren't built in are skipped.
+static int replaySelTrace(boost::asio::io_context& io,
+                          const std::string& file, bool fast)
+{
+    std::vector<SelTraceRecord> records;
+    if (!readSelTrace(file, records))
+    {
+        std::cerr << file << " is not a trace\n";
+        return EXIT_FAILURE;
+    }
+    // Only the logging service needs a connection
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+
+#if defined(SEL_LOGGER_MONITOR_THRESHOLD_EVENTS) ||                            \
+    defined(SEL_LOGGER_MONITOR_THRESHOLD_ALARM_EVENTS)
+    // Answer each sensor's metadata lookups with the replies that were
+    // captured for it, in the order they were captured
+    auto replies = std::make_shared<boost::container::flat_map<
+        std::string, std::deque<SensorMetadataReply>>>();
+    for (const SelTraceRecord& record : records)
+    {
+        if (record.kind != SelTraceKind::sensorMetadata)
+        {
+            continue;
+        }
+        if (std::optional<SensorMetadataReply> reply =
+                selTraceDecode<SensorMetadataReply>(record.payload))
+        {
+            (*replies)[reply->path + '/' + reply->threshold].push_back(*reply);
+        }
+    }
+    SensorMetadataLookup getMetadata =
+        [replies](const std::string&, const std::string& path,
+                  const std::string&, const std::string& threshold,
+                  SensorMetadataCache::MetadataHandler&& handler) {
+            std::deque<SensorMetadataReply>& queue =
+                (*replies)[path + '/' + threshold];
+            if (queue.empty())
+            {
+                handler(std::nullopt, std::nullopt);
+                return;
+            }
+            SensorMetadataReply reply = std::move(queue.front());
+            queue.pop_front();
+            handler(reply.sensorValue(), reply.thresholdValue);
+        };
+    auto flapSuppressor =
+        std::make_shared<FlapSuppressor>(io, conn, flapSuppressionConfig);
+#endif
+
+    SelTracePlayer player(
+        io, std::move(records), fast, [&](const SelTraceRecord& record) {
+#ifdef SEL_LOGGER_WRITER_THREAD
+            // Nothing else is served meanwhile, so wait for the writer rather
+            // than drop records that weren't dropped live
+            getSelWriter().waitForRoom();
+#endif
+            switch (record.kind)
+            {
+#ifdef SEL_LOGGER_MONITOR_THRESHOLD_EVENTS
+                case SelTraceKind::thresholdAsserted:
+                {
+                    auto signal =
+                        selTraceDecode<ThresholdAssertedSignal>(record.payload);
+                    if (signal)
+                    {
+                        handleThresholdAsserted(conn, getMetadata,
+                                                flapSuppressor, *signal);
+                    }
+                    return signal.has_value();
+                }
+#endif
+#ifdef SEL_LOGGER_MONITOR_THRESHOLD_ALARM_EVENTS
+                case SelTraceKind::thresholdAlarm:
+                {
+                    auto signal =
+                        selTraceDecode<ThresholdAlarmSignal>(record.payload);
+                    if (signal)
+                    {
+                        handleThresholdAlarm(conn, getMetadata, flapSuppressor,
+                                             *signal);
+                    }
+                    return signal.has_value();
+                }
+#endif
+#if defined(SEL_LOGGER_MONITOR_THRESHOLD_EVENTS) ||                            \
+    defined(SEL_LOGGER_MONITOR_THRESHOLD_ALARM_EVENTS)
+                case SelTraceKind::sensorMetadata:
+                    // Already queued up for the lookups
+                    return true;
+#endif
+#ifdef SEL_LOGGER_MONITOR_WATCHDOG_EVENTS
+                case SelTraceKind::watchdogTimeout:
+                {
+                    auto timeout =
+                        selTraceDecode<WatchdogTimeoutEvent>(record.payload);
+                    if (timeout)
+                    {
+                        SelMetricsScope metricsScope(SelMetricSource::watchdog);
+                        logWatchdogTimeout(conn, *timeout);
+                    }
+                    return timeout.has_value();
+                }
+#endif
+#ifdef REDFISH_LOG_MONITOR_PULSE_EVENTS
+                case SelTraceKind::hostState:
+                {
+                    auto signal =
+                        selTraceDecode<HostStateSignal>(record.payload);
+                    if (signal)
+                    {
+                        handleHostStateChange(conn, *signal);
+                    }
+                    return signal.has_value();
+                }
+#endif
+#ifdef SEL_LOGGER_MONITOR_HOST_ERROR_EVENTS
+                case SelTraceKind::hostError:
+                {
+                    auto signal =
+                        selTraceDecode<HostErrorSignal>(record.payload);
+                    if (signal)
+                    {
+                        handleHostError(conn, *signal);
+                    }
+                    return signal.has_value();
+                }
+#endif
+                case SelTraceKind::ipmiSelAdd:
+                {
+                    auto call = selTraceDecode<IpmiSelAddCall>(record.payload);
+                    if (!call)
+                    {
+                        return false;
+                    }
+                    SelMetricsScope metricsScope(SelMetricSource::ipmiSelAdd);
+                    try
+                    {
+                        selAddSystemRecord(conn, call->message, call->path,
+                                           call->selData, call->assert,
+                                           call->genId,
+                                           selDBusSensorInfo(call->path));
+                    }
+                    catch (const std::exception& e)
+                    {
+                        // Rejected live as well
+                        std::cerr << "IpmiSelAdd failed: " << e.what()
+                                  << "\n";
+                    }
+                    return true;
+                }
+                case SelTraceKind::ipmiSelAddOem:
+                {
+                    auto call =
+                        selTraceDecode<IpmiSelAddOemCall>(record.payload);
+                    if (!call)
+                    {
+                        return false;
+                    }
+                    SelMetricsScope metricsScope(
+                        SelMetricSource::ipmiSelAddOem);
+                    try
+                    {
+                        selAddOemRecord(conn, call->message, call->selData,
+                                        call->recordType);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::cerr << "IpmiSelAddOem failed: " << e.what()
+                                  << "\n";
+                    }
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        });
+    player.start();
+    // Runs until the last record and everything it set off, such as flap
+    // summaries, is done
+    io.run();
+#ifdef SEL_LOGGER_WRITER_THREAD
+    getSelWriter().drain();
+#endif
+    std::cerr << "Replayed " << player.replayed << " records, skipped "
+              << player.skipped << "\n";
+    return EXIT_SUCCESS;
+}
+#endif
+
+int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
+{
     boost::asio::io_context io;
+
+#ifdef SEL_LOGGER_TRACE
+    // --capture FILE traces everything the monitors and add methods receive,
+    // --replay FILE [--fast] feeds a trace to them instead of the bus
+    std::string captureFile;
+    std::string replayFile;
+    [[maybe_unused]] bool replayFast = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--fast")
+        {
+            replayFast = true;
+        }
+        else if ((arg == "--capture" || arg == "--replay") && i + 1 < argc)
+        {
+            (arg == "--capture" ? captureFile : replayFile) = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (!replayFile.empty())
+    {
+#ifdef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+        std::cerr << "Replay needs the logging service on the bus\n";
+        return EXIT_FAILURE;
+#else
+        initializeSelState(io);
+        return replaySelTrace(io, replayFile, replayFast);
+#endif
+    }
+    if (!captureFile.empty() && !getSelTraceCapture().open(captureFile))
+    {
+        return EXIT_FAILURE;
+    }
+#endif
+
+    // setup connection to dbus
     auto conn = std::make_shared<sdbusplus::asio::connection>(io);
 
     // IPMI SEL Object
     conn->request_name(ipmiSelObject);
+
+    // Recover the record ID state only now, so reading the log files doesn't
+    // hold up taking the D-Bus name.  No method call can be handled before
+    // io.run() anyway.
+    initializeSelState(io);
     auto server = sdbusplus::asio::object_server(conn);
 
     // Add SEL Interface
     std::shared_ptr<sdbusplus::asio::dbus_interface> ifaceAddSel =
         server.add_interface(ipmiSelPath, ipmiSelAddInterface);
 
+#ifdef SEL_LOGGER_WRITER_THREAD
+    // The add methods only reply once their records are committed
+    ifaceAddSel->register_method(
+        "IpmiSelAdd",
+        [conn](boost::asio::yield_context yield, const std::string& message,
+               const std::string& path, const std::vector<uint8_t>& selData,
+               const bool& assert, const uint16_t& genId) {
+            selTraceAdd(message, path, selData, assert, genId);
+            size_t count = selSystemRecordPriority(selData, assert) ==
+                                   SelWritePriority::normal
+                               ? 1
+                               : 0;
+            return selAddAndWait(conn, yield, count, [&]() {
+                SelMetricsScope metricsScope(SelMetricSource::ipmiSelAdd);
+                return selAddSystemRecord(conn, message, path, selData, assert,
+                                          genId, selDBusSensorInfo(path));
+            });
+        });
+    ifaceAddSel->register_method(
+        "IpmiSelAddOem",
+        [conn](boost::asio::yield_context yield, const std::string& message,
+               const std::vector<uint8_t>& selData, const uint8_t& recordType) {
+            selTraceAddOem(message, selData, recordType);
+            return selAddAndWait(conn, yield, 1, [&]() {
+                SelMetricsScope metricsScope(SelMetricSource::ipmiSelAddOem);
+                return selAddOemRecord(conn, message, selData, recordType);
+            });
+        });
+    ifaceAddSel->register_method(
+        "IpmiSelAddBatch", [conn](boost::asio::yield_context yield,
+                                  const std::vector<SelSystemEntry>& entries) {
+            selTraceAddBatch(entries);
+            size_t count = selNormalRecordCount(entries);
+            return selAddAndWait(conn, yield, count, [&]() {
+                SelMetricsScope metricsScope(SelMetricSource::ipmiSelAdd,
+                                             entries.size());
+                return selAddSystemRecords(conn, entries);
+            });
+        });
+    ifaceAddSel->register_method(
+        "IpmiSelAddOemBatch", [conn](boost::asio::yield_context yield,
+                                     const std::vector<SelOemEntry>& entries) {
+            selTraceAddOemBatch(entries);
+            return selAddAndWait(conn, yield, entries.size(), [&]() {
+                SelMetricsScope metricsScope(SelMetricSource::ipmiSelAddOem,
+                                             entries.size());
+                return selAddOemRecords(conn, entries);
+            });
+        });
+#else
     // Add a new SEL entry
     ifaceAddSel->register_method(
         "IpmiSelAdd",
         [conn](const std::string& message, const std::string& path,
                const std::vector<uint8_t>& selData, const bool& assert,
                const uint16_t& genId) {
+            selTraceAdd(message, path, selData, assert, genId);
+            SelMetricsScope metricsScope(SelMetricSource::ipmiSelAdd);
             return selAddSystemRecord(conn, message, path, selData, assert,
-                                      genId);
+                                      genId, selDBusSensorInfo(path));
         });
     // Add a new OEM SEL entry
     ifaceAddSel->register_method(
         "IpmiSelAddOem",
         [conn](const std::string& message, const std::vector<uint8_t>& selData,
                const uint8_t& recordType) {
+            selTraceAddOem(message, selData, recordType);
+            SelMetricsScope metricsScope(SelMetricSource::ipmiSelAddOem);
             return selAddOemRecord(conn, message, selData, recordType);
         });
+    // Add several SEL entries in a single call
+    ifaceAddSel->register_method(
+        "IpmiSelAddBatch", [conn](const std::vector<SelSystemEntry>& entries) {
+            selTraceAddBatch(entries);
+            SelMetricsScope metricsScope(SelMetricSource::ipmiSelAdd,
+                                         entries.size());
+            return selAddSystemRecords(conn, entries);
+        });
+    // Add several OEM SEL entries in a single call
+    ifaceAddSel->register_method(
+        "IpmiSelAddOemBatch", [conn](const std::vector<SelOemEntry>& entries) {
+            selTraceAddOemBatch(entries);
+            SelMetricsScope metricsScope(SelMetricSource::ipmiSelAddOem,
+                                         entries.size());
+            return selAddOemRecords(conn, entries);
+        });
+#endif
 
 #ifndef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+#ifdef SEL_LOGGER_WRITER_THREAD
+    // Clear and SELDelete wait for the writer without blocking the main loop
+    ifaceAddSel->register_method(
+        "Clear", [conn](boost::asio::yield_context yield) {
+            clearSelLogFiles(conn, yield);
+        });
+#ifdef SEL_LOGGER_ENABLE_SEL_DELETE
+    ifaceAddSel->register_method(
+        "SELDelete",
+        [&io](boost::asio::yield_context yield, const uint16_t& recordId) {
+            return selDeleteRecord(io, yield, recordId);
+        });
+#endif
+#else
     // Clear SEL entries
-    ifaceAddSel->register_method("Clear", []() { clearSelLogFiles(); });
+    ifaceAddSel->register_method("Clear", [conn]() {
+        clearSelLogFiles(conn, SelMethodYield{});
+    });
 #ifdef SEL_LOGGER_ENABLE_SEL_DELETE
     // Delete a SEL entry
-    ifaceAddSel->register_method("SELDelete", [](const uint16_t& recordId) {
-        return selDeleteRecord(recordId);
-    });
+    ifaceAddSel->register_method(
+        "SELDelete", [&io](const uint16_t& recordId) {
+            return selDeleteRecord(io, SelMethodYield{}, recordId);
+        });
+#endif
 #endif
 #endif
     ifaceAddSel->initialize();
 
+#ifdef SEL_LOGGER_METRICS
+    // Counters and latency histograms of everything the daemon handles
+    std::shared_ptr<sdbusplus::asio::dbus_interface> ifaceMetrics =
+        server.add_interface(selMetricsPath, selMetricsInterface);
+    ifaceMetrics->register_method(
+        "GetCounters", []() { return getSelMetrics().counters(); });
+    ifaceMetrics->register_method("GetLatencyHistograms", []() {
+        return getSelMetrics().latencyHistograms();
+    });
+#ifndef SEL_LOGGER_SEND_TO_LOGGING_SERVICE
+    ifaceMetrics->register_method("GetFreeRecordIds",
+                                  []() { return selFreeRecordIds(); });
+#endif
+    ifaceMetrics->initialize();
+#endif
+
+#if defined(SEL_LOGGER_MONITOR_THRESHOLD_EVENTS) ||                            \
+    defined(SEL_LOGGER_MONITOR_HOST_ERROR_EVENTS)
+    // Pick up the asserted events from before a restart, so a restart doesn't
+    // log duplicate asserts or lose deasserts
+    MonitorStateSnapshot monitorSnapshot(io, assertedEventsSnapshotFile);
+    bool warmRestart = monitorSnapshot.start();
+#endif
+
+#if defined(SEL_LOGGER_MONITOR_THRESHOLD_EVENTS) ||                            \
+    defined(SEL_LOGGER_MONITOR_THRESHOLD_ALARM_EVENTS)
+    // Both threshold monitors share one cache of sensor properties, and one
+    // limit on how fast a sensor's transitions are logged
+    auto sensorCache =
+        std::make_shared<SensorMetadataCache>(conn, selDeadlineConfig);
+    auto flapSuppressor =
+        std::make_shared<FlapSuppressor>(io, conn, flapSuppressionConfig);
+#endif
+
 #ifdef SEL_LOGGER_MONITOR_THRESHOLD_EVENTS
-    sdbusplus::match thresholdAssertMonitor = startThresholdAssertMonitor(conn);
+    sdbusplus::match thresholdAssertMonitor =
+        startThresholdAssertMonitor(conn, sensorCache, flapSuppressor);
 #endif
 
 #ifdef REDFISH_LOG_MONITOR_PULSE_EVENTS
@@ -472,16 +1518,49 @@ int main(int, char*[])
 #endif
 
 #ifdef SEL_LOGGER_MONITOR_WATCHDOG_EVENTS
-    sdbusplus::match watchdogEventMonitor = startWatchdogEventMonitor(conn);
+    std::unique_ptr<WatchdogEventMonitor> watchdogEventMonitor =
+        startWatchdogEventMonitor(conn, selDeadlineConfig);
 #endif
 
 #ifdef SEL_LOGGER_MONITOR_THRESHOLD_ALARM_EVENTS
-    startThresholdAlarmMonitor(conn);
+    startThresholdAlarmMonitor(conn, sensorCache, flapSuppressor);
 #endif
 
 #ifdef SEL_LOGGER_MONITOR_HOST_ERROR_EVENTS
     startHostErrorEventMonitor(conn);
 #endif
+
+#if defined(SEL_LOGGER_MONITOR_THRESHOLD_EVENTS) ||                            \
+    defined(SEL_LOGGER_MONITOR_HOST_ERROR_EVENTS)
+    // After a restart, catch up on any events that changed while the daemon
+    // was down.  The monitors are already running, so nothing is missed in
+    // between.
+    if (warmRestart)
+    {
+        std::vector<std::string> reconcileInterfaces;
+#ifdef SEL_LOGGER_MONITOR_THRESHOLD_EVENTS
+        reconcileInterfaces.emplace_back(
+            "xyz.openbmc_project.Sensor.Threshold.Warning");
+        reconcileInterfaces.emplace_back(
+            "xyz.openbmc_project.Sensor.Threshold.Critical");
+#endif
+#ifdef SEL_LOGGER_MONITOR_HOST_ERROR_EVENTS
+        for (const auto& [name, match] : hostErrorMatches)
+        {
+            reconcileInterfaces.emplace_back(hostErrorInterfacePrefix + name);
+        }
+#endif
+        getManagedObjects(
+            conn, reconcileInterfaces, [conn](const ManagedObjects& objects) {
+#ifdef SEL_LOGGER_MONITOR_THRESHOLD_EVENTS
+                reconcileThresholdEvents(conn, objects);
+#endif
+#ifdef SEL_LOGGER_MONITOR_HOST_ERROR_EVENTS
+                reconcileHostErrorEvents(conn, objects);
+#endif
+            });
+    }
+#endif
     io.run();
 
     return 0;
@@ -0,0 +1,245 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Checks that SelLogIndex finds and removes ipmi_sel lines in place, keeping
+// the offsets of the remaining lines right, and that readHighestSelRecordId()
+// recovers the record ID from the end of a file, including lines split across
+// the 4 KiB read chunks and a partial last line.
+
+#include <sel_log_index.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+static size_t failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if (!ok)
+    {
+        std::cerr << "FAIL: " << what << "\n";
+        failures++;
+    }
+}
+
+static std::string selLine(uint16_t recordId, size_t padding = 0)
+{
+    return "2026-10-16T12:00:00.000000+00:00 " + std::to_string(recordId) +
+           ",2,20000001FF0101FFFF,/xyz/openbmc_project/sensors/temperature/" +
+           std::string(padding, 'x') + ",0x20\n";
+}
+
+static std::string readFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>()};
+}
+
+static void writeFile(const std::filesystem::path& path,
+                      const std::string& contents)
+{
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+}
+
+static void appendFile(const std::filesystem::path& path,
+                       const std::string& contents)
+{
+    std::ofstream(path, std::ios::binary | std::ios::app) << contents;
+}
+
+// Check that the index points at the line of recordId in contents
+static void checkLocation(SelLogIndex& index, const std::string& contents,
+                          uint16_t recordId, const std::string& what)
+{
+    std::optional<SelLogIndex::Location> location = index.find(recordId);
+    if (!location)
+    {
+        check(false, what + ": record " + std::to_string(recordId) +
+                         " not found");
+        return;
+    }
+    std::string line = contents.substr(location->offset, location->length);
+    check(!line.empty() && line.back() == '\n' &&
+              parseSelLineRecordId(line.substr(0, line.size() - 1)) ==
+                  recordId,
+          what + ": record " + std::to_string(recordId) + " at offset " +
+              std::to_string(location->offset));
+}
+
+static void removeSeveralLines(const std::filesystem::path& dir)
+{
+    std::filesystem::path log = dir / "ipmi_sel";
+    std::string contents;
+    for (uint16_t recordId = 1; recordId <= 20; recordId++)
+    {
+        contents += selLine(recordId, recordId % 7);
+    }
+    writeFile(log, contents);
+
+    SelLogIndex index(dir, "ipmi_sel");
+    index.refresh();
+    check(index.size() == 20, "remove: all lines indexed");
+
+    // The first, some in the middle, two next to each other and the last
+    std::vector<uint16_t> toRemove = {1, 5, 9, 10, 20, 42};
+    std::vector<uint16_t> removed = index.remove(toRemove);
+    check(removed.size() == 5, "remove: found every record but 42");
+
+    std::string expected;
+    for (uint16_t recordId = 1; recordId <= 20; recordId++)
+    {
+        if (recordId != 1 && recordId != 5 && recordId != 9 &&
+            recordId != 10 && recordId != 20)
+        {
+            expected += selLine(recordId, recordId % 7);
+        }
+    }
+    contents = readFile(log);
+    check(contents == expected, "remove: file holds the remaining lines");
+    check(index.size() == 15, "remove: removed records dropped");
+    for (uint16_t recordId : removed)
+    {
+        check(!index.find(recordId), "remove: record " +
+                                         std::to_string(recordId) +
+                                         " still indexed");
+    }
+    for (uint16_t recordId = 1; recordId <= 20; recordId++)
+    {
+        if (std::find(removed.begin(), removed.end(), recordId) ==
+            removed.end())
+        {
+            checkLocation(index, contents, recordId, "remove");
+        }
+    }
+
+    // The moved offsets must still be right for records appended later and
+    // for another removal without a refresh in between
+    appendFile(log, selLine(21));
+    check(index.remove(uint16_t{11}), "remove: second removal");
+    contents = readFile(log);
+    check(contents.find(selLine(11)) == std::string::npos,
+          "remove: second removal rewrote the file");
+    for (uint16_t recordId : {2, 3, 12, 19, 21})
+    {
+        checkLocation(index, contents, recordId, "remove again");
+    }
+}
+
+static void lineAcrossChunk(const std::filesystem::path& dir)
+{
+    std::filesystem::path log = dir / "ipmi_sel";
+    // Fill up to just before the 4 KiB boundary, so the next line straddles
+    // it, then add enough lines that the last read chunk splits one too
+    std::string contents;
+    uint16_t recordId = 1;
+    while (contents.size() + selLine(recordId).size() < 4096 - 10)
+    {
+        contents += selLine(recordId++);
+    }
+    uint16_t straddling = recordId;
+    contents += selLine(recordId++, 20);
+    check(contents.size() > 4096, "chunk: a line straddles the boundary");
+    while (contents.size() < 3 * 4096)
+    {
+        contents += selLine(recordId, recordId % 13);
+        recordId++;
+    }
+    uint16_t last = recordId - 1;
+    writeFile(log, contents);
+
+    SelLogIndex index(dir, "ipmi_sel");
+    index.refresh();
+    check(index.size() == last, "chunk: all lines indexed");
+    checkLocation(index, contents, straddling, "chunk");
+    checkLocation(index, contents, last, "chunk");
+
+    check(index.remove(straddling), "chunk: remove the straddling line");
+    contents = readFile(log);
+    checkLocation(index, contents, straddling + 1, "chunk");
+    checkLocation(index, contents, last, "chunk");
+
+    // Ask for one more record than the file holds, so every line is parsed,
+    // across each chunk boundary, when reading backwards
+    size_t count = last;
+    std::optional<uint16_t> highest = readHighestSelRecordId(log, count);
+    check(highest == last, "chunk: highest record ID");
+    check(count == 1, "chunk: every line counted once");
+}
+
+static void partialLastLine(const std::filesystem::path& dir)
+{
+    std::filesystem::path log = dir / "ipmi_sel";
+    std::string complete = selLine(1) + selLine(2) + selLine(3);
+    std::string next = selLine(4);
+    // Cut before the record ID, as if rsyslog was still writing the line
+    std::string partial = next.substr(0, next.find(' ') + 1);
+    writeFile(log, complete + partial);
+
+    SelLogIndex index(dir, "ipmi_sel");
+    index.refresh();
+    check(index.size() == 3, "partial: last line not indexed");
+    check(!index.find(4), "partial: record 4 not found");
+
+    size_t count = 2;
+    check(readHighestSelRecordId(log, count) == 3,
+          "partial: highest record ID skips the partial line");
+    check(count == 0, "partial: partial line not counted");
+
+    // Once the line is finished it is indexed where it started
+    appendFile(log, next.substr(partial.size()));
+    std::string contents = readFile(log);
+    checkLocation(index, contents, 4, "partial");
+    check(index.remove(uint16_t{4}), "partial: remove the finished line");
+    check(readFile(log) == complete, "partial: file back to complete lines");
+
+    // A file with a single line and no newline at all
+    writeFile(log, next.substr(0, next.size() - 1));
+    count = 1;
+    check(readHighestSelRecordId(log, count) == 4,
+          "partial: single line without a newline");
+}
+
+int main()
+{
+    std::string dirTemplate =
+        (std::filesystem::temp_directory_path() / "sel-log-index-XXXXXX")
+            .string();
+    if (mkdtemp(dirTemplate.data()) == nullptr)
+    {
+        std::cerr << "failed to create a temporary directory\n";
+        return EXIT_FAILURE;
+    }
+    std::filesystem::path dir = dirTemplate;
+
+    for (auto test : {removeSeveralLines, lineAcrossChunk, partialLastLine})
+    {
+        std::filesystem::remove(dir / "ipmi_sel");
+        test(dir);
+    }
+    std::filesystem::remove_all(dir);
+
+    std::cout << failures << " failures\n";
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,118 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Sweeps sensor ranges and readings and checks that the cached scaling path,
+// getScaledIPMIValue(), gives exactly the bytes the uncached
+// scaleIPMIValueFromDouble() does, and rejects the same ranges.
+
+#include <sensorutils.hpp>
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+static std::optional<uint8_t> scaleUncached(double value, double max,
+                                            double min)
+{
+    int16_t mValue = 0;
+    int8_t rExp = 0;
+    int16_t bValue = 0;
+    int8_t bExp = 0;
+    bool bSigned = false;
+    if (!ipmi::getSensorAttributes(max, min, mValue, rExp, bValue, bExp,
+                                   bSigned))
+    {
+        return std::nullopt;
+    }
+    return ipmi::scaleIPMIValueFromDouble(value, mValue, rExp, bValue, bExp,
+                                          bSigned);
+}
+
+static std::optional<uint8_t> scaleCached(double value, double max,
+                                          double min)
+{
+    try
+    {
+        return ipmi::getScaledIPMIValue(value, max, min);
+    }
+    catch (const std::runtime_error&)
+    {
+        return std::nullopt;
+    }
+}
+
+int main()
+{
+    size_t failures = 0;
+
+    for (int exponent = -ipmi::pow10TableMax;
+         exponent <= ipmi::pow10TableMax; exponent++)
+    {
+        if (std::bit_cast<uint64_t>(ipmi::pow10(exponent)) !=
+            std::bit_cast<uint64_t>(std::pow(10.0, exponent)))
+        {
+            std::cerr << "pow10(" << exponent << ") differs from std::pow\n";
+            failures++;
+        }
+    }
+
+    // Ranges of real sensors, tiny and huge ones, ranges crossing zero and
+    // ones the scaling rejects
+    const std::vector<std::pair<double, double>> ranges = {
+        {0, 255},       {-128, 127},    {0, 1},         {0, 0.001},
+        {-40, 125},     {0, 16000},     {0, 3000},      {0, 65535},
+        {0, 14.1},      {1.2, 1.8},     {-0.5, 0.5},    {0, 1e6},
+        {-1e9, 1e9},    {100, 100.5},   {0, 2.5e-6},    {-273.15, 1000},
+        {5, 5},         {10, 0},        {0, INFINITY},  {NAN, 10},
+        {-INFINITY, 0}, {0, 1e30},      {1e-30, 2e-30}, {-3.3, -1.1},
+    };
+    constexpr int steps = 2000;
+    size_t compared = 0;
+    for (const auto& [min, max] : ranges)
+    {
+        double span = std::isfinite(max - min) ? max - min : 1.0;
+        // Go past both ends to cover the clamping, and run the sweep twice
+        // so the second pass is served from the cache
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int i = -steps / 10; i <= steps + steps / 10; i++)
+            {
+                double value = min + span * i / steps;
+                std::optional<uint8_t> expected =
+                    scaleUncached(value, max, min);
+                std::optional<uint8_t> actual = scaleCached(value, max, min);
+                compared++;
+                if (expected != actual)
+                {
+                    std::cerr << "range [" << min << ", " << max
+                              << "] value " << value << ": expected "
+                              << (expected ? int(*expected) : -1) << " got "
+                              << (actual ? int(*actual) : -1) << "\n";
+                    failures++;
+                }
+            }
+        }
+    }
+
+    std::cout << compared << " values compared, " << failures
+              << " failures\n";
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2026 OpenBMC Authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Run sel-logger-stress for a short, light load and check its counters.
+
+Usage: stress_test.py SEL_LOGGER_STRESS SEL_LOGGER
+
+The load is light enough that no call should fail or be dropped.  Skipped,
+with exit code 77, when there is no dbus-daemon to start a private bus with.
+"""
+
+import json
+import shutil
+import subprocess
+import sys
+
+SKIP = 77
+
+
+def check(condition, message):
+    if not condition:
+        print("FAIL: " + message, file=sys.stderr)
+        sys.exit(1)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__, file=sys.stderr)
+        return 1
+    stress, sel_logger = sys.argv[1:]
+    if shutil.which("dbus-daemon") is None:
+        print("dbus-daemon not found, skipping")
+        return SKIP
+
+    output = subprocess.run(
+        [
+            stress,
+            "--sel-logger", sel_logger,
+            "--duration", "2",
+            "--add-rate", "200",
+            "--oem-rate", "50",
+            "--threshold-rate", "20",
+            "--alarm-rate", "20",
+            "--sensors", "4",
+        ],
+        stdout=subprocess.PIPE,
+        check=True,
+        timeout=50,
+    ).stdout
+    print(output.decode())
+    report = json.loads(output)
+
+    calls = report["calls"]
+    for name in ("IpmiSelAdd", "IpmiSelAddOem"):
+        call = calls[name]
+        check(call["sent"] > 0, name + " calls were sent")
+        check(call["failed"] == 0, name + " calls failed")
+        check(call["completed"] == call["sent"], name + " calls all replied")
+    for name, signal in report["signals"].items():
+        check(signal["sent"] > 0, name + " signals were sent")
+
+    # Only there when sel-logger was built with metrics
+    metrics = report["sel_logger"].get("metrics", {})
+    for name in ("IpmiSelAdd", "IpmiSelAddOem"):
+        if name not in metrics:
+            continue
+        counters = metrics[name]
+        received = counters["EventsReceived"]
+        check(
+            received == calls[name]["completed"],
+            name + " events received match the calls made",
+        )
+        # With send-to-logger there's no logging service on the private bus,
+        # so records fail rather than being written
+        check(
+            counters["RecordsWritten"]
+            + counters["RecordsSuppressed"]
+            + counters["DBusFailures"]
+            == received,
+            name + " events are all accounted for",
+        )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,607 @@
+/*
+// Copyright (c) 2026 OpenBMC Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+// Floods a sel-logger running on a private bus with method calls and sensor
+// signals, and reports the throughput and latency it sustained as JSON.
+//
+// A private dbus-daemon is started and sel-logger is launched with it as its
+// system bus, so nothing else on the machine sees the traffic.  The records
+// still go wherever that sel-logger build writes them, so use a build and a
+// machine where that doesn't matter.
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/container/flat_map.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const char* ipmiSelObject = "xyz.openbmc_project.Logging.IPMI";
+constexpr const char* ipmiSelPath = "/xyz/openbmc_project/Logging/IPMI";
+constexpr const char* ipmiSelAddInterface = "xyz.openbmc_project.Logging.IPMI";
+constexpr const char* metricsPath = "/xyz/openbmc_project/Logging/IPMI/Metrics";
+constexpr const char* metricsInterface =
+    "xyz.openbmc_project.Logging.IPMI.Metrics";
+
+struct StressConfig
+{
+    std::string selLogger = "sel-logger";
+    std::chrono::seconds duration{10};
+    // Events per second of each kind
+    double addRate = 1000;
+    double oemRate = 100;
+    double thresholdRate = 100;
+    double alarmRate = 100;
+    size_t sensors = 16;
+    // Most method calls waiting for a reply at once
+    size_t concurrency = 64;
+};
+
+void usage()
+{
+    std::cerr << "Usage: sel-logger-stress [--sel-logger PATH] [--duration S]\n"
+                 "         [--add-rate N] [--oem-rate N] [--threshold-rate N]\n"
+                 "         [--alarm-rate N] [--sensors N] [--concurrency N]\n";
+}
+
+std::optional<StressConfig> parseArgs(int argc, char* argv[])
+{
+    StressConfig config;
+    for (int i = 1; i < argc; i += 2)
+    {
+        std::string_view arg(argv[i]);
+        if (i + 1 >= argc)
+        {
+            return std::nullopt;
+        }
+        const char* value = argv[i + 1];
+        if (arg == "--sel-logger")
+        {
+            config.selLogger = value;
+        }
+        else if (arg == "--duration")
+        {
+            config.duration = std::chrono::seconds(std::atoi(value));
+        }
+        else if (arg == "--add-rate")
+        {
+            config.addRate = std::atof(value);
+        }
+        else if (arg == "--oem-rate")
+        {
+            config.oemRate = std::atof(value);
+        }
+        else if (arg == "--threshold-rate")
+        {
+            config.thresholdRate = std::atof(value);
+        }
+        else if (arg == "--alarm-rate")
+        {
+            config.alarmRate = std::atof(value);
+        }
+        else if (arg == "--sensors")
+        {
+            config.sensors = std::max(1, std::atoi(value));
+        }
+        else if (arg == "--concurrency")
+        {
+            config.concurrency = std::max(1, std::atoi(value));
+        }
+        else
+        {
+            return std::nullopt;
+        }
+    }
+    return config;
+}
+
+// Start a program with stdout going to stdoutFd, if given
+pid_t spawn(const std::vector<std::string>& args, int stdoutFd = -1)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+    if (stdoutFd >= 0)
+    {
+        dup2(stdoutFd, STDOUT_FILENO);
+    }
+    std::vector<char*> argv;
+    for (const std::string& arg : args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    execvp(argv[0], argv.data());
+    std::cerr << "Failed to run " << args[0] << "\n";
+    _exit(127);
+}
+
+void stop(pid_t pid)
+{
+    if (pid > 0)
+    {
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+// Start a private bus and return its process and address
+std::optional<std::pair<pid_t, std::string>> startBus()
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+    {
+        return std::nullopt;
+    }
+    pid_t pid = spawn(
+        {"dbus-daemon", "--session", "--nofork", "--nopidfile",
+         "--print-address"},
+        fds[1]);
+    close(fds[1]);
+    std::string address;
+    char c = 0;
+    while (read(fds[0], &c, 1) == 1 && c != '\n')
+    {
+        address.push_back(c);
+    }
+    close(fds[0]);
+    if (address.empty())
+    {
+        stop(pid);
+        return std::nullopt;
+    }
+    return std::make_pair(pid, address);
+}
+
+// Peak resident set size of a process in KiB, from /proc
+uint64_t peakRss(pid_t pid)
+{
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.starts_with("VmHWM:"))
+        {
+            return std::strtoull(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+double percentile(std::vector<double>& samples, double fraction)
+{
+    if (samples.empty())
+    {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+// Upper bound in microseconds of the log2 bucket holding a percentile of a
+// sel-logger latency histogram
+uint64_t histogramPercentile(const std::vector<uint64_t>& buckets,
+                             double fraction)
+{
+    uint64_t total = 0;
+    for (uint64_t count : buckets)
+    {
+        total += count;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++)
+    {
+        seen += buckets[i];
+        if (total != 0 && seen >= std::ceil(fraction * total))
+        {
+            return uint64_t{1} << i;
+        }
+    }
+    return 0;
+}
+
+struct MockSensor
+{
+    std::string name;
+    std::string path;
+    bool thresholdAsserted = false;
+    bool alarmAsserted = false;
+};
+
+// Counts of a stream of events sent at a fixed rate
+struct Stream
+{
+    explicit Stream(double rate) : rate(rate) {}
+
+    double rate;
+    uint64_t sent = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    std::vector<double> latencies;
+
+    // Events that should have been sent by now but haven't been
+    uint64_t due(std::chrono::duration<double> elapsed) const
+    {
+        auto target = static_cast<uint64_t>(rate * elapsed.count());
+        return target > sent ? target - sent : 0;
+    }
+};
+
+class StressRun
+{
+  public:
+    StressRun(boost::asio::io_context& io,
+              std::shared_ptr<sdbusplus::asio::connection> conn,
+              const StressConfig& config) :
+        io(io), conn(conn), server(conn), config(config), timer(io),
+        add(config.addRate), oem(config.oemRate),
+        threshold(config.thresholdRate), alarm(config.alarmRate)
+    {
+        for (size_t i = 0; i < config.sensors; i++)
+        {
+            addSensor("stress_" + std::to_string(i));
+        }
+    }
+
+    void run()
+    {
+        start = Clock::now();
+        tick();
+        io.run();
+        elapsed = Clock::now() - start;
+    }
+
+    void report(pid_t selLoggerPid)
+    {
+        std::cout << "{\n  \"duration_s\": " << elapsed.count()
+                  << ",\n  \"calls\": {";
+        reportCalls("IpmiSelAdd", add, true);
+        reportCalls("IpmiSelAddOem", oem, false);
+        std::cout << "\n  },\n  \"signals\": {";
+        reportSignals("ThresholdAsserted", threshold, true);
+        reportSignals("ThresholdAlarm", alarm, false);
+        std::cout << "\n  },\n  \"sel_logger\": {\n    \"peak_rss_kib\": "
+                  << peakRss(selLoggerPid);
+        reportMetrics();
+        std::cout << "\n  }\n}\n";
+    }
+
+  private:
+    void addSensor(const std::string& name)
+    {
+        MockSensor sensor{name,
+                          "/xyz/openbmc_project/sensors/temperature/" + name};
+        auto value = server.add_interface(sensor.path,
+                                          "xyz.openbmc_project.Sensor.Value");
+        value->register_property("Value", 50.0);
+        value->register_property("MaxValue", 127.0);
+        value->register_property("MinValue", -128.0);
+        value->initialize();
+        auto warning = server.add_interface(
+            sensor.path, "xyz.openbmc_project.Sensor.Threshold.Warning");
+        warning->register_property("WarningHigh", 80.0);
+        warning->register_property("WarningLow", 5.0);
+        warning->register_property("WarningAlarmHigh", false);
+        warning->register_property("WarningAlarmLow", false);
+        warning->initialize();
+        auto critical = server.add_interface(
+            sensor.path, "xyz.openbmc_project.Sensor.Threshold.Critical");
+        critical->register_property("CriticalHigh", 95.0);
+        critical->register_property("CriticalLow", 0.0);
+        critical->register_property("CriticalAlarmHigh", false);
+        critical->register_property("CriticalAlarmLow", false);
+        critical->initialize();
+        interfaces.insert(interfaces.end(), {value, warning, critical});
+        sensors.push_back(std::move(sensor));
+    }
+
+    // Send whatever is due, every millisecond until the run is over
+    void tick()
+    {
+        std::chrono::duration<double> now = Clock::now() - start;
+        bool sending = now < config.duration;
+        if (sending)
+        {
+            for (uint64_t n = add.due(now); n > 0 && room(); n--)
+            {
+                sendAdd();
+            }
+            for (uint64_t n = oem.due(now); n > 0 && room(); n--)
+            {
+                sendOem();
+            }
+            for (uint64_t n = threshold.due(now); n > 0; n--)
+            {
+                sendThreshold();
+            }
+            for (uint64_t n = alarm.due(now); n > 0; n--)
+            {
+                sendAlarm();
+            }
+        }
+        // Give the calls still in flight a few seconds to finish
+        if (!sending && (outstanding == 0 || now > config.duration +
+                                                       std::chrono::seconds(5)))
+        {
+            io.stop();
+            return;
+        }
+        timer.expires_after(std::chrono::milliseconds(1));
+        timer.async_wait([this](const boost::system::error_code& ec) {
+            if (!ec)
+            {
+                tick();
+            }
+        });
+    }
+
+    bool room() const
+    {
+        return outstanding < config.concurrency;
+    }
+
+    template <typename Reply>
+    auto completion(Stream& stream)
+    {
+        outstanding++;
+        stream.sent++;
+        return [this, &stream, sent = Clock::now()](
+                   boost::system::error_code ec, Reply) {
+            outstanding--;
+            if (ec)
+            {
+                stream.failed++;
+                return;
+            }
+            stream.completed++;
+            stream.latencies.push_back(
+                std::chrono::duration<double, std::micro>(Clock::now() - sent)
+                    .count());
+        };
+    }
+
+    void sendAdd()
+    {
+        const MockSensor& sensor = sensors[add.sent % sensors.size()];
+        std::vector<uint8_t> data{0x09, static_cast<uint8_t>(add.sent), 0xFF};
+        conn->async_method_call(completion<uint16_t>(add), ipmiSelObject,
+                                ipmiSelPath, ipmiSelAddInterface, "IpmiSelAdd",
+                                sensor.name + " stress event", sensor.path,
+                                data, true, uint16_t{0x0020});
+    }
+
+    void sendOem()
+    {
+        std::vector<uint8_t> data(13, static_cast<uint8_t>(oem.sent));
+        conn->async_method_call(completion<uint16_t>(oem), ipmiSelObject,
+                                ipmiSelPath, ipmiSelAddInterface,
+                                "IpmiSelAddOem", std::string("stress event"),
+                                data, uint8_t{0xC0});
+    }
+
+    // Each signal is a transition, so none of them are duplicates
+    void sendThreshold()
+    {
+        MockSensor& sensor = sensors[threshold.sent++ % sensors.size()];
+        sensor.thresholdAsserted = !sensor.thresholdAsserted;
+        sdbusplus::message_t signal = conn->new_signal(
+            sensor.path.c_str(), "xyz.openbmc_project.Sensor.Threshold",
+            "ThresholdAsserted");
+        signal.append(sensor.name,
+                      std::string("xyz.openbmc_project.Sensor.Threshold."
+                                  "Critical"),
+                      std::string("CriticalAlarmHigh"),
+                      sensor.thresholdAsserted,
+                      sensor.thresholdAsserted ? 100.0 : 50.0);
+        signal.signal_send();
+    }
+
+    void sendAlarm()
+    {
+        MockSensor& sensor = sensors[alarm.sent++ % sensors.size()];
+        sensor.alarmAsserted = !sensor.alarmAsserted;
+        sdbusplus::message_t signal = conn->new_signal(
+            sensor.path.c_str(), "xyz.openbmc_project.Sensor.Threshold.Warning",
+            sensor.alarmAsserted ? "WarningHighAlarmAsserted"
+                                 : "WarningHighAlarmDeasserted");
+        signal.append(sensor.alarmAsserted ? 85.0 : 50.0);
+        signal.signal_send();
+    }
+
+    void reportCalls(std::string_view name, Stream& stream, bool first)
+    {
+        std::cout << (first ? "\n" : ",\n") << "    \"" << name
+                  << "\": {\"sent\": " << stream.sent
+                  << ", \"completed\": " << stream.completed
+                  << ", \"failed\": " << stream.failed
+                  << ", \"per_s\": " << stream.completed / elapsed.count()
+                  << ", \"p50_us\": " << percentile(stream.latencies, 0.5)
+                  << ", \"p99_us\": " << percentile(stream.latencies, 0.99)
+                  << "}";
+    }
+
+    void reportSignals(std::string_view name, const Stream& stream,
+                       bool first)
+    {
+        std::cout << (first ? "\n" : ",\n") << "    \"" << name
+                  << "\": {\"sent\": " << stream.sent
+                  << ", \"per_s\": " << stream.sent / elapsed.count() << "}";
+    }
+
+    // Signals have no reply to time, so their latency comes from the
+    // daemon's own metrics, when it was built with them
+    void reportMetrics()
+    {
+        using Counters = boost::container::flat_map<
+            std::string, boost::container::flat_map<std::string, uint64_t>>;
+        using Histograms =
+            boost::container::flat_map<std::string, std::vector<uint64_t>>;
+        Counters counters;
+        Histograms histograms;
+        try
+        {
+            sdbusplus::message_t call = conn->new_method_call(
+                ipmiSelObject, metricsPath, metricsInterface, "GetCounters");
+            conn->call(call).read(counters);
+            call = conn->new_method_call(ipmiSelObject, metricsPath,
+                                         metricsInterface,
+                                         "GetLatencyHistograms");
+            conn->call(call).read(histograms);
+        }
+        catch (const sdbusplus::exception_t&)
+        {
+            // Built without metrics
+            return;
+        }
+        std::cout << ",\n    \"metrics\": {";
+        bool first = true;
+        for (const auto& [source, values] : counters)
+        {
+            std::cout << (first ? "\n" : ",\n") << "      \"" << source
+                      << "\": {";
+            for (const auto& [counter, value] : values)
+            {
+                std::cout << "\"" << counter << "\": " << value << ", ";
+            }
+            const std::vector<uint64_t>& buckets = histograms[source];
+            std::cout << "\"p50_us_at_most\": "
+                      << histogramPercentile(buckets, 0.5)
+                      << ", \"p99_us_at_most\": "
+                      << histogramPercentile(buckets, 0.99) << "}";
+            first = false;
+        }
+        std::cout << "\n    }";
+    }
+
+    boost::asio::io_context& io;
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    sdbusplus::asio::object_server server;
+    StressConfig config;
+    boost::asio::steady_timer timer;
+    std::vector<MockSensor> sensors;
+    std::vector<std::shared_ptr<sdbusplus::asio::dbus_interface>> interfaces;
+    Stream add;
+    Stream oem;
+    Stream threshold;
+    Stream alarm;
+    size_t outstanding = 0;
+    Clock::time_point start;
+    std::chrono::duration<double> elapsed{0};
+};
+
+// Wait for sel-logger to take its name on the bus
+bool waitForSelLogger(sdbusplus::asio::connection& conn, pid_t pid)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(10);
+    while (Clock::now() < deadline)
+    {
+        if (waitpid(pid, nullptr, WNOHANG) == pid)
+        {
+            return false;
+        }
+        sdbusplus::message_t call = conn.new_method_call(
+            "org.freedesktop.DBus", "/org/freedesktop/DBus",
+            "org.freedesktop.DBus", "NameHasOwner");
+        call.append(std::string(ipmiSelObject));
+        bool hasOwner = false;
+        conn.call(call).read(hasOwner);
+        if (hasOwner)
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::optional<StressConfig> config = parseArgs(argc, argv);
+    if (!config)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::optional<std::pair<pid_t, std::string>> bus = startBus();
+    if (!bus)
+    {
+        std::cerr << "Failed to start a private dbus-daemon\n";
+        return EXIT_FAILURE;
+    }
+    auto [busPid, address] = *bus;
+    // Both sel-logger and this tool connect to the default bus, which these
+    // make the private one
+    setenv("DBUS_SYSTEM_BUS_ADDRESS", address.c_str(), 1);
+    setenv("DBUS_STARTER_ADDRESS", address.c_str(), 1);
+    setenv("DBUS_STARTER_BUS_TYPE", "system", 1);
+
+    pid_t selLoggerPid = spawn({config->selLogger});
+    int status = EXIT_SUCCESS;
+    try
+    {
+        boost::asio::io_context io;
+        auto conn = std::make_shared<sdbusplus::asio::connection>(io);
+        if (!waitForSelLogger(*conn, selLoggerPid))
+        {
+            std::cerr << "sel-logger did not start\n";
+            status = EXIT_FAILURE;
+        }
+        else
+        {
+            StressRun run(io, conn, *config);
+            run.run();
+            run.report(selLoggerPid);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        status = EXIT_FAILURE;
+    }
+
+    stop(selLoggerPid);
+    stop(busPid);
+    return status;
+}